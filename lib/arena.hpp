@@ -0,0 +1,70 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+namespace xpertium {
+
+/**
+ * Monotonic memory of a knowledge database. Objects are placed one after
+ * another in large blocks and the memory is released at once with the arena
+ */
+using arena_t = std::pmr::monotonic_buffer_resource;
+
+/**
+ * @brief Returns a memory resource of containers which are placed in the
+ *        arena or the heap if the arena is `nullptr`
+ */
+inline std::pmr::memory_resource *arena_resource(arena_t *arena) {
+    return arena ? arena : std::pmr::new_delete_resource();
+}
+
+/**
+ * This class must be a parent of objects which can be placed in an arena.
+ * `new (arena) obj_t(...)` places the object in the arena, a plain `new` (or
+ * `nullptr` arena) uses the heap. Both objects are deleted by `delete`, so
+ * owners don't depend on where objects live, but only heap objects return
+ * their memory
+ */
+class arena_object_t {
+    /**
+     * Every object is preceded by a pointer of its arena, the size keeps
+     * objects aligned like `operator new` does
+     */
+    static constexpr std::size_t header = alignof(std::max_align_t);
+public:
+    static void *operator new(std::size_t size) {
+        return allocate(size, nullptr);
+    }
+
+    static void *operator new(std::size_t size, arena_t *arena) {
+        return allocate(size, arena);
+    }
+
+    static void operator delete(void *ptr) {
+        if (!ptr) { return; }
+        auto base = static_cast<char *>(ptr) - header;
+        if (!*reinterpret_cast<arena_t **>(base)) { ::operator delete(base); }
+    }
+
+    /**
+     * @brief Releases memory if the constructor of a placed object throws
+     */
+    static void operator delete(void *ptr, arena_t *) {
+        arena_object_t::operator delete(ptr);
+    }
+private:
+    static void *allocate(std::size_t size, arena_t *arena) {
+        auto base = static_cast<char *>(
+            arena ? arena->allocate(size + header, header)
+                  : ::operator new(size + header));
+        *reinterpret_cast<arena_t **>(base) = arena;
+        return base + header;
+    }
+};
+
+}
+
+#endif // ARENA_HPP
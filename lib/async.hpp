@@ -0,0 +1,317 @@
+#ifndef ASYNC_HPP
+#define ASYNC_HPP
+
+#include "kb.hpp"
+#include "matcher.hpp"
+#include "prover.hpp"
+#include "session.hpp"
+#include "tracer.hpp"
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace xpertium {
+
+/**
+ * This class represents a lazily started coroutine which returns a result to
+ * the coroutine awaiting it. A finished task resumes its caller directly, so
+ * nested tasks don't grow the stack of the thread which resumes them
+ */
+template <typename res_t>
+class task_t {
+public:
+    struct promise_type;
+private:
+    using handle_t = std::coroutine_handle<promise_type>;
+
+    struct final_awaiter_t {
+        bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<>
+        await_suspend(handle_t handle) const noexcept {
+            return handle.promise().caller;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    handle_t m_handle;
+public:
+    struct promise_type {
+        res_t result{};
+        std::coroutine_handle<> caller = std::noop_coroutine();
+        std::exception_ptr error;
+
+        task_t<res_t> get_return_object() {
+            return task_t<res_t>(handle_t::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        final_awaiter_t final_suspend() const noexcept { return {}; }
+        void return_value(res_t res) { result = std::move(res); }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    /**
+     * @brief Constructor of an empty task
+     */
+    task_t() = default;
+
+    /**
+     * @brief Constructor
+     * @param handle Coroutine
+     */
+    explicit task_t(handle_t handle) : m_handle{handle} {}
+
+    /**
+     * @brief Deletes a copy constructor
+     */
+    task_t(const task_t<res_t> &) = delete;
+
+    /**
+     * @brief Move constructor
+     */
+    task_t(task_t &&other) noexcept :
+        m_handle{std::exchange(other.m_handle, {})} {}
+
+    /**
+     * @brief Deletes a copy assignment
+     */
+    task_t<res_t> &operator=(const task_t<res_t> &) = delete;
+
+    /**
+     * @brief Move assignment
+     */
+    task_t<res_t> &operator=(task_t &&other) noexcept {
+        if (this != &other) {
+            if (m_handle) { m_handle.destroy(); }
+            m_handle = std::exchange(other.m_handle, {});
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Destructor, it destroys the coroutine even if it's suspended
+     */
+    ~task_t() { if (m_handle) { m_handle.destroy(); } }
+
+    /**
+     * @brief Returns `true` if the task is empty or finished
+     */
+    bool done() const { return !m_handle || m_handle.done(); }
+
+    /**
+     * @brief Runs the task until it's suspended or finished
+     */
+    void resume() { m_handle.resume(); }
+
+    /**
+     * @brief Returns the result of the finished task
+     */
+    res_t result() const {
+        if (m_handle.promise().error) {
+            std::rethrow_exception(m_handle.promise().error);
+        }
+        return m_handle.promise().result;
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<> caller) noexcept {
+        m_handle.promise().caller = caller;
+        return m_handle;
+    }
+
+    res_t await_resume() const { return result(); }
+};
+
+/**
+ * This class runs a consultation as a coroutine. Instead of blocking in a
+ * dialogue the consultation is suspended on every question and the question
+ * is returned to the caller, which resumes it by `answer()` when the answer
+ * is ready. So a single thread can interleave any number of consultations.
+ *
+ * The direct output is run by `matcher_t` like `direct_mode_t::rete` of
+ * `expert_t` and the reverse output by `prover_t`, their questions are
+ * awaited
+ */
+template <typename val_t>
+class async_expert_t {
+    const kb_t<val_t> *m_kb;
+    base_tracer_t<val_t> &m_tracer;
+    std::ostream &m_out;
+    session_t<val_t> m_session;
+    task_t<bool> m_task;
+    const quest_t<val_t> *m_quest = nullptr;
+    std::coroutine_handle<> m_asking;
+    val_t m_answer{};
+    std::uint32_t m_max_depth = prover_t<val_t>::no_depth;
+
+    /**
+     * This class suspends the consultation until the question is answered
+     */
+    struct ask_t {
+        async_expert_t<val_t> *expert;
+        const quest_t<val_t> *quest;
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle) noexcept {
+            expert->m_quest = quest;
+            expert->m_asking = handle;
+        }
+
+        val_t await_resume() {
+            expert->m_quest = nullptr;
+            return std::move(expert->m_answer);
+        }
+    };
+public:
+    /**
+     * @brief Constructor
+     * @param kb Knowledge database
+     * @param tracer Stack tracer
+     * @param out Stream for messages of the consultation
+     */
+    async_expert_t(const kb_t<val_t> *kb, base_tracer_t<val_t> &tracer,
+                   std::ostream &out) :
+        m_kb{kb}, m_tracer{tracer}, m_out{out}, m_session{kb} {}
+
+    /**
+     * @brief Deletes a copy constructor, suspended coroutines refer to
+     *        the object
+     */
+    async_expert_t(const async_expert_t<val_t> &) = delete;
+
+    /**
+     * @brief Deletes a copy assignment
+     */
+    async_expert_t<val_t> &operator=(const async_expert_t<val_t> &) = delete;
+
+    /**
+     * @brief Returns the largest number of nested goals of the reverse output
+     */
+    std::uint32_t max_depth() const { return m_max_depth; }
+
+    /**
+     * @brief Sets the largest number of nested goals of the reverse output,
+     *        deeper goals aren't proved
+     * @param depth Depth (`prover_t::no_depth` - no limit)
+     */
+    void max_depth(std::uint32_t depth) { m_max_depth = depth; }
+
+    /**
+     * @brief Returns the state of the current consultation
+     */
+    const session_t<val_t> &session() const { return m_session; }
+
+    /**
+     * @brief Aborts the current consultation and resets all known facts
+     * @param init Initial facts
+     */
+    void reset(const std::vector<val_t> *init = nullptr) {
+        m_task = task_t<bool>();
+        m_quest = nullptr;
+        m_session.reset();
+        m_tracer.clear();
+        if (init) {
+            for (auto it = init->begin(); it != init->end(); ++it) {
+                auto fact = m_kb->symbols()->find(*it);
+                if (fact != no_sym) { facts().insert(fact); }
+                m_tracer.push_fact(*it);
+            }
+        }
+    }
+
+    /**
+     * @brief Starts the reverse output
+     * @param target_fact The target fact
+     * @return The first question or `nullptr` if the consultation is done
+     */
+    const quest_t<val_t> *reverse(const val_t target_fact) {
+        auto target = m_kb->symbols()->find(target_fact);
+        return start(reverse_root(target));
+    }
+
+    /**
+     * @brief Starts the direct output
+     * @param target_fact The target fact (`nullptr` to run for any target)
+     * @return The first question or `nullptr` if the consultation is done
+     */
+    const quest_t<val_t> *direct(const val_t *target_fact = nullptr) {
+        return start(direct_impl(target_fact));
+    }
+
+    /**
+     * @brief Resumes the consultation with the answer to the current question
+     * @param answer Answer
+     * @return The next question or `nullptr` if the consultation is done
+     */
+    const quest_t<val_t> *answer(val_t answer) {
+        if (!m_quest) { return nullptr; }
+
+        m_answer = std::move(answer);
+        m_asking.resume();
+
+        return m_quest;
+    }
+
+    /**
+     * @brief Returns the question the consultation waits for or `nullptr`
+     */
+    const quest_t<val_t> *question() const { return m_quest; }
+
+    /**
+     * @brief Returns `true` if the consultation is finished
+     */
+    bool done() const { return m_task.done(); }
+
+    /**
+     * @brief Returns `true` if the finished consultation achieved the target
+     */
+    bool result() const { return done() && m_task.result(); }
+private:
+    const quest_t<val_t> *start(task_t<bool> task) {
+        m_task = std::move(task);
+        m_quest = nullptr;
+        m_task.resume();
+
+        return m_quest;
+    }
+
+    task_t<bool> reverse_root(sym_t target) {
+        bool result = false;
+        if (target != no_sym) {
+            prover_t<val_t> prover(m_kb, m_session, m_tracer, m_out);
+            prover.max_depth(m_max_depth);
+            auto quest = prover.prove(target);
+            while (quest) {
+                quest = prover.answer(co_await ask_t{this, quest});
+            }
+            result = prover.result();
+        }
+        if (result) { m_out << "Target is reachable!" << std::endl; }
+        else { m_out << "Target isn't reachable!" << std::endl; }
+
+        co_return result;
+    }
+
+    task_t<bool> direct_impl(const val_t *target_fact) {
+        matcher_t<val_t> matcher(m_kb, m_session, m_tracer, m_out);
+        auto quest = matcher.match(target_fact);
+        while (quest) { quest = matcher.answer(co_await ask_t{this, quest}); }
+
+        co_return matcher.result();
+    }
+
+    fact_db_t &facts() { return m_session.facts(); }
+};
+
+}
+
+#endif // ASYNC_HPP
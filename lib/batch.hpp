@@ -0,0 +1,191 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include "bitmap.hpp"
+#include "kb.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace xpertium {
+
+/**
+ * This class represents a batch of fact databases stored by columns: every
+ * interned fact has a column of bits, one bit per row. Rows are grouped by 64
+ * into blocks, so a block of a column is a single word
+ */
+class fact_batch_t {
+    std::size_t m_facts;
+    std::size_t m_rows;
+    std::size_t m_blocks;
+    std::vector<std::uint64_t> m_words;
+public:
+    /**
+     * @brief Constructor of a batch without facts
+     * @param facts Number of interned facts
+     * @param rows Number of rows
+     */
+    fact_batch_t(std::size_t facts = 0, std::size_t rows = 0) :
+        m_facts{facts}, m_rows{rows}, m_blocks{(rows + 63) / 64},
+        m_words(facts * m_blocks) {}
+
+    fact_batch_t(const fact_batch_t &) = default;
+    fact_batch_t(fact_batch_t &&) = default;
+
+    fact_batch_t &operator=(const fact_batch_t &) = default;
+    fact_batch_t &operator=(fact_batch_t &&) = default;
+
+    /**
+     * @brief Returns a number of facts
+     */
+    std::size_t facts() const { return m_facts; }
+
+    /**
+     * @brief Returns a number of rows
+     */
+    std::size_t rows() const { return m_rows; }
+
+    /**
+     * @brief Returns a number of blocks of 64 rows
+     */
+    std::size_t blocks() const { return m_blocks; }
+
+    /**
+     * @brief Returns `true` if the fact is known in the row
+     */
+    bool test(sym_t fact, std::size_t row) const {
+        return word(fact, row / 64) >> (row % 64) & 1;
+    }
+
+    /**
+     * @brief Adds the fact to the row
+     */
+    void set(sym_t fact, std::size_t row) {
+        word(fact, row / 64) |= std::uint64_t(1) << (row % 64);
+    }
+
+    /**
+     * @brief Returns bits of the column for the block of rows
+     */
+    std::uint64_t word(sym_t fact, std::size_t block) const {
+        return m_words[fact * m_blocks + block];
+    }
+
+    /**
+     * @brief Returns bits of the column for the block of rows
+     */
+    std::uint64_t &word(sym_t fact, std::size_t block) {
+        return m_words[fact * m_blocks + block];
+    }
+
+    /**
+     * @brief Returns facts known in the row
+     */
+    vals_t<sym_t> row(std::size_t row) const {
+        vals_t<sym_t> facts;
+        for (std::size_t fact = 0; fact < m_facts; ++fact) {
+            if (test(static_cast<sym_t>(fact), row)) {
+                facts.push_back(static_cast<sym_t>(fact));
+            }
+        }
+
+        return facts;
+    }
+};
+
+/**
+ * This class runs the direct output for a batch of fact databases at once.
+ * Activating expressions are evaluated for 64 rows by a single pass of their
+ * programs over bit columns.
+ *
+ * Unlike `expert_t::direct` it doesn't stop at the first target: every row
+ * is saturated and all targets derived in the row are returned. Rules are
+ * activated in the order of the incremental strategy. Questions are never
+ * asked: answers are taken from a batch of pre-supplied answers, and a
+ * question which has no answer in a row gives nothing in that row
+ */
+template <typename val_t>
+class batch_expert_t {
+    const kb_t<val_t> *m_kb;
+public:
+    /**
+     * @brief Constructor
+     * @param kb Knowledge database
+     */
+    explicit batch_expert_t(const kb_t<val_t> *kb) : m_kb{kb} {}
+
+    /**
+     * @brief Derives targets for every row of the batch
+     * @param init Initial facts of rows
+     * @param answers Answers of rows, the answer fact of a question is set
+     *                if the row gives that answer
+     * @return Targets derived in rows
+     */
+    fact_batch_t direct(const fact_batch_t &init,
+                        const fact_batch_t &answers) const {
+        auto nfacts = m_kb->symbols()->size();
+        auto rules = m_kb->rules();
+        fact_batch_t targets(nfacts, init.rows());
+        std::vector<std::uint64_t> facts(nfacts);
+        std::vector<std::uint64_t> given(nfacts);
+        std::vector<std::uint64_t> stack;
+        bitmap_t pending(rules->size());
+
+        for (std::size_t block = 0; block < init.blocks(); ++block) {
+            for (sym_t fact = 0; fact < nfacts; ++fact) {
+                facts[fact] = column(init, fact, block);
+                given[fact] = column(answers, fact, block);
+            }
+
+            // Padding rows of the last block stay without facts
+            auto rows = init.rows() - block * 64;
+            auto mask = rows < 64 ? (std::uint64_t(1) << rows) - 1
+                                  : ~std::uint64_t(0);
+
+            pending = bitmap_t(rules->size(), true);
+            auto idx = pending.next(0);
+            while (idx != bitmap_t::npos) {
+                pending.reset(idx);
+                const auto &rule = *(*rules)[idx];
+                auto active = rule.program().is(facts.data(), stack) & mask;
+                if (active) {
+                    if (rule.question()) {
+                        for (const auto &ans : rule.question()->answers()) {
+                            derive(rule, ans.fact(), active & given[ans.fact()],
+                                   facts, targets, block, pending);
+                        }
+                    } else if (rule.out() != no_sym) {
+                        derive(rule, rule.out(), active, facts, targets, block,
+                               pending);
+                    }
+                }
+                idx = pending.next(idx + 1);
+                if (idx == bitmap_t::npos) { idx = pending.next(0); }
+            }
+        }
+
+        return targets;
+    }
+private:
+    static std::uint64_t column(const fact_batch_t &batch, sym_t fact,
+                                std::size_t block) {
+        return fact < batch.facts() ? batch.word(fact, block) : 0;
+    }
+
+    /**
+     * @brief Adds the fact to the rows and schedules rules watching it
+     */
+    void derive(const rule_t<val_t> &rule, sym_t fact, std::uint64_t rows,
+                std::vector<std::uint64_t> &facts, fact_batch_t &targets,
+                std::size_t block, bitmap_t &pending) const {
+        if (rule.target()) { targets.word(fact, block) |= rows; }
+        if (!(rows & ~facts[fact])) { return; }
+
+        facts[fact] |= rows;
+        for (auto w : m_kb->watchers(fact)) { pending.set(w); }
+    }
+};
+
+}
+
+#endif // BATCH_HPP
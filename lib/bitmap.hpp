@@ -0,0 +1,104 @@
+#ifndef BITMAP_HPP
+#define BITMAP_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace xpertium {
+
+/**
+ * This class represents a fixed-size set of bits with a fast search of the
+ * next set bit
+ */
+class bitmap_t {
+    std::vector<std::uint64_t> m_words;
+    std::size_t m_size;
+public:
+    /**
+     * Returned by `next()` when there are no more set bits
+     */
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    /**
+     * @brief Constructor
+     * @param size Number of bits
+     * @param value Initial value of bits
+     */
+    explicit bitmap_t(std::size_t size = 0, bool value = false) :
+        m_words((size + 63) / 64, value ? ~std::uint64_t(0) : 0),
+        m_size{size} {
+        if (value && size % 64) {
+            m_words.back() = (std::uint64_t(1) << (size % 64)) - 1;
+        }
+    }
+
+    bitmap_t(const bitmap_t &) = default;
+    bitmap_t(bitmap_t &&) = default;
+
+    bitmap_t &operator=(const bitmap_t &) = default;
+    bitmap_t &operator=(bitmap_t &&) = default;
+
+    /**
+     * @brief Returns a number of bits
+     */
+    std::size_t size() const { return m_size; }
+
+    /**
+     * @brief Returns the bit value
+     */
+    bool test(std::size_t idx) const {
+        return m_words[idx / 64] >> (idx % 64) & 1;
+    }
+
+    /**
+     * @brief Sets the bit
+     */
+    void set(std::size_t idx) {
+        m_words[idx / 64] |= std::uint64_t(1) << (idx % 64);
+    }
+
+    /**
+     * @brief Clears the bit
+     */
+    void reset(std::size_t idx) {
+        m_words[idx / 64] &= ~(std::uint64_t(1) << (idx % 64));
+    }
+
+    /**
+     * @brief Clears all bits
+     */
+    void clear() { std::fill(m_words.begin(), m_words.end(), 0); }
+
+    /**
+     * @brief Returns `true` if any bit is set
+     */
+    bool any() const {
+        for (auto w : m_words) { if (w) { return true; } }
+        return false;
+    }
+
+    /**
+     * @brief Returns an index of the first set bit starting from `from`
+     * @param from Start index
+     * @return Index of the bit or `npos`
+     */
+    std::size_t next(std::size_t from) const {
+        if (from >= m_size) { return npos; }
+
+        auto word = from / 64;
+        auto bits = m_words[word] & (~std::uint64_t(0) << (from % 64));
+        while (!bits) {
+            if (++word == m_words.size()) { return npos; }
+            bits = m_words[word];
+        }
+
+        return word * 64 + static_cast<std::size_t>(std::countr_zero(bits));
+    }
+};
+
+}
+
+#endif // BITMAP_HPP
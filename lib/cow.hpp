@@ -0,0 +1,245 @@
+#ifndef COW_HPP
+#define COW_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace xpertium {
+
+/**
+ * This class shares data between its copies until one of them writes it:
+ * copying costs O(1) and the first write by a copy clones the data. Copies
+ * can be used by different threads, but a single copy can't be written
+ * concurrently
+ */
+template <typename data_t>
+class cow_t {
+    struct node_t {
+        std::atomic<std::size_t> refs{1};
+        data_t data;
+
+        explicit node_t(const data_t &data) : data(data) {}
+    };
+
+    node_t *m_node = nullptr;
+public:
+    /**
+     * @brief Constructor of an empty pointer
+     */
+    cow_t() = default;
+
+    /**
+     * @brief Constructor
+     * @param data Data
+     */
+    explicit cow_t(const data_t &data) : m_node{new node_t(data)} {}
+
+    cow_t(const cow_t<data_t> &other) : m_node{other.m_node} {
+        if (m_node) { m_node->refs.fetch_add(1, std::memory_order_relaxed); }
+    }
+
+    ~cow_t() { release(); }
+
+    cow_t<data_t> &operator=(const cow_t<data_t> &other) {
+        // The copy keeps the source valid, so moves are copies
+        cow_t<data_t> tmp(other);
+        std::swap(m_node, tmp.m_node);
+        return *this;
+    }
+
+    /**
+     * @brief Returns `true` if the pointer isn't empty
+     */
+    explicit operator bool() const { return m_node; }
+
+    /**
+     * @brief Returns the data for reading
+     */
+    const data_t &operator*() const { return m_node->data; }
+
+    /**
+     * @brief Returns the data for reading
+     */
+    const data_t *operator->() const { return &m_node->data; }
+
+    /**
+     * @brief Returns `true` if no other copy shares the data
+     */
+    bool unique() const {
+        return m_node->refs.load(std::memory_order_acquire) == 1;
+    }
+
+    /**
+     * @brief Returns the data for writing, it's cloned if it's shared
+     */
+    data_t &write() {
+        if (!unique()) {
+            auto node = new node_t(m_node->data);
+            release();
+            m_node = node;
+        }
+
+        return m_node->data;
+    }
+private:
+    void release() {
+        if (m_node &&
+                m_node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete m_node;
+        }
+    }
+};
+
+/**
+ * This class represents an array which can be forked. Items are kept in a
+ * flat vector until the first `fork()`, which moves them to pages shared by
+ * forks of the array: then a fork costs O(1) and a write clones only the
+ * table of pages and the page it changes. Arrays which are never forked
+ * don't pay for the indirection
+ */
+template <typename item_t, std::size_t page_size>
+class cow_array_t {
+    using page_t = std::array<item_t, page_size>;
+
+    struct root_t {
+        std::vector<cow_t<page_t>> pages;
+        std::size_t size = 0;
+    };
+
+    std::vector<item_t> m_items;
+    cow_t<root_t> m_root;
+public:
+    /**
+     * @brief Constructor
+     * @param size Number of value-initialized items
+     */
+    explicit cow_array_t(std::size_t size = 0) : m_items(size) {}
+
+    cow_array_t(const cow_array_t &) = default;
+    cow_array_t(cow_array_t &&) = default;
+
+    cow_array_t &operator=(const cow_array_t &) = default;
+    cow_array_t &operator=(cow_array_t &&) = default;
+
+    /**
+     * @brief Returns an array which shares items with this one, the items
+     *        are moved to pages if the array wasn't forked yet
+     */
+    cow_array_t fork() {
+        if (!m_root) { page(); }
+        return *this;
+    }
+
+    /**
+     * @brief Returns `true` if items are kept in pages after a fork
+     */
+    bool forked() const { return static_cast<bool>(m_root); }
+
+    /**
+     * @brief Returns a number of items
+     */
+    std::size_t size() const {
+        return m_root ? m_root->size : m_items.size();
+    }
+
+    /**
+     * @brief Returns `true` if the array is empty
+     */
+    bool empty() const { return !size(); }
+
+    /**
+     * @brief Returns an item for reading
+     */
+    const item_t &operator[](std::size_t idx) const {
+        if (!m_root) { return m_items[idx]; }
+        return (*m_root->pages[idx / page_size])[idx % page_size];
+    }
+
+    /**
+     * @brief Returns an item for writing, its page is cloned if it's shared
+     */
+    item_t &write(std::size_t idx) {
+        if (!m_root) { return m_items[idx]; }
+        return item(m_root.write(), idx);
+    }
+
+    /**
+     * @brief Returns the last item
+     */
+    const item_t &back() const { return (*this)[size() - 1]; }
+
+    /**
+     * @brief Appends the item
+     */
+    void push_back(const item_t &value) {
+        if (!m_root) {
+            m_items.push_back(value);
+            return;
+        }
+
+        auto &root = m_root.write();
+        if (root.size == root.pages.size() * page_size) {
+            root.pages.emplace_back(page_t());
+        }
+        item(root, root.size++) = value;
+    }
+
+    /**
+     * @brief Changes a number of items, new items are value-initialized.
+     *        Pages are kept when the array shrinks
+     * @param size Number of items
+     */
+    void resize(std::size_t size) {
+        if (!m_root) {
+            m_items.resize(size);
+            return;
+        }
+
+        auto &root = m_root.write();
+        auto kept = std::min(size, root.pages.size() * page_size);
+        for (auto idx = root.size; idx < kept; ++idx) {
+            item(root, idx) = item_t();
+        }
+        while (root.pages.size() * page_size < size) {
+            root.pages.emplace_back(page_t());
+        }
+        root.size = size;
+    }
+
+    /**
+     * @brief Removes all items, a forked array becomes flat again
+     */
+    void clear() {
+        m_items.clear();
+        m_root = cow_t<root_t>();
+    }
+private:
+    static item_t &item(root_t &root, std::size_t idx) {
+        return root.pages[idx / page_size].write()[idx % page_size];
+    }
+
+    /**
+     * @brief Moves items from the vector to pages
+     */
+    void page() {
+        root_t root;
+        root.size = m_items.size();
+        for (std::size_t pos = 0; pos < m_items.size(); pos += page_size) {
+            page_t page{};
+            auto end = std::min(m_items.size(), pos + page_size);
+            std::copy(m_items.begin() + pos, m_items.begin() + end,
+                      page.begin());
+            root.pages.emplace_back(page);
+        }
+        m_root = cow_t<root_t>(root);
+        m_items = std::vector<item_t>();
+    }
+};
+
+}
+
+#endif // COW_HPP
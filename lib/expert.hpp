@@ -1,23 +1,54 @@
 #ifndef EXPERT_SYSTEM_H
 #define EXPERT_SYSTEM_H
 
+#include "bitmap.hpp"
 #include "dialog.hpp"
+#include "goal.hpp"
 #include "kb.hpp"
+#include "matcher.hpp"
+#include "pool.hpp"
+#include "prover.hpp"
+#include "rete.hpp"
+#include "session.hpp"
 #include "tracer.hpp"
 
 #include <algorithm>
-#include <iterator> // for back_inserter
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <sstream>
 #include <vector>
 
 namespace xpertium {
 
+/**
+ * Strategies of the direct output
+ */
+enum class direct_mode_t {
+    scan,        ///< Rescans all rules until no rule can be activated
+    incremental, ///< Rechecks only rules that mention newly added facts
+    rete,        ///< Matches rules by the discrimination network of the KB
+    stratified,  ///< Checks rules once by strata, only cycles are repeated
+    magic        ///< Checks only rules demanded by the target
+};
+
+/**
+ * This class runs consultations over a shared knowledge database, the state
+ * of a consultation is kept in its own session
+ */
 template <typename val_t>
 class expert_t {
     const kb_t<val_t> *m_kb;
     const base_dialog_t<val_t> &m_dialog;
     base_tracer_t<val_t> &m_tracer;
-    vals_t<val_t> m_facts;
-    std::vector<rule_t<val_t> *> m_cur_rules;
+    session_t<val_t> m_session;
+    direct_mode_t m_direct_mode = direct_mode_t::scan;
+    std::uint32_t m_max_depth = prover_t<val_t>::no_depth;
+
+    /**
+     * Smallest number of rules which a worker of the pool evaluates at once
+     */
+    static constexpr std::size_t min_chunk = 512;
 public:
     /**
      * @brief Constructor
@@ -27,7 +58,7 @@ public:
      */
     expert_t(const kb_t<val_t> *kb, const base_dialog_t<val_t> &dialog,
              base_tracer_t<val_t> &tracer) :
-        m_kb{kb}, m_dialog{dialog}, m_tracer{tracer} {}
+        m_kb{kb}, m_dialog{dialog}, m_tracer{tracer}, m_session{kb} {}
 
     /**
      * @brief Copy constructor
@@ -44,21 +75,46 @@ public:
      */
     expert_t<val_t> &operator=(expert_t &&) = default;
 
+    /**
+     * @brief Returns the strategy of the direct output
+     */
+    direct_mode_t direct_mode() const { return m_direct_mode; }
+
+    /**
+     * @brief Sets the strategy of the direct output
+     * @param mode Strategy
+     */
+    void direct_mode(direct_mode_t mode) { m_direct_mode = mode; }
+
+    /**
+     * @brief Returns the largest number of nested goals of the reverse output
+     */
+    std::uint32_t max_depth() const { return m_max_depth; }
+
+    /**
+     * @brief Sets the largest number of nested goals of the reverse output,
+     *        deeper goals aren't proved
+     * @param depth Depth (`prover_t::no_depth` - no limit)
+     */
+    void max_depth(std::uint32_t depth) { m_max_depth = depth; }
+
+    /**
+     * @brief Returns the state of the current consultation
+     */
+    const session_t<val_t> &session() const { return m_session; }
+
     /**
      * @brief Resets all known facts
      * @param init Initial facts
      */
     void reset(const std::vector<val_t> *init = nullptr) {
-        m_cur_rules.clear();
-        auto rules = m_kb->rules();
-        std::for_each(rules->begin(), rules->end(), [this] (const auto &p) {
-            m_cur_rules.push_back(p.get());
-        });
-        m_facts.clear();
+        m_session.reset();
         m_tracer.clear();
         if (init) {
             for (auto it = init->begin(); it != init->end(); ++it) {
-                m_facts.push_back(*it);
+                // Facts unknown by the KB can't activate any rule
+                auto fact = m_kb->symbols()->find(*it);
+                if (fact != no_sym) { facts().insert(fact); }
                 m_tracer.push_fact(*it);
             }
         }
@@ -70,50 +126,100 @@ public:
      * @return True if the target was achieved
      */
     bool reverse(const val_t target_fact) {
-        bool result = reverse_impl(target_fact);
-        if (result) {
-            m_dialog.print() << "Target is reachable!" << std::endl;
-        } else {
-            m_dialog.print() << "Target isn't reachable!" << std::endl;
+        auto target = m_kb->symbols()->find(target_fact);
+        return print_reached(target != no_sym && prove(target));
+    }
+
+    /**
+     * @brief Launch the expert system with the speculative reverse output.
+     *        If proofs of the target can't ask questions, rules which
+     *        produce it are tried by the pool: every rule is proved in its
+     *        own fork of the session, the first rule in the order of
+     *        `reverse()` which succeeds cancels the rules after it and its
+     *        fork becomes the session. If all of them fail, the target is
+     *        proved by `reverse()`.
+     *
+     *        It isn't equivalent to `reverse()`: a rule isn't proved after
+     *        the failed rules before it, so it doesn't see facts, used rules
+     *        and failed goals they left. The target can be achieved by
+     *        rules which `reverse()` consumes in a failed proof, so it can
+     *        be achieved where `reverse()` fails but not vice versa. The
+     *        trace has only the proof of the successful rule
+     * @param target_fact The target fact
+     * @param pool Thread pool
+     * @return True if the target was achieved
+     */
+    bool reverse_speculative(const val_t target_fact, thread_pool_t &pool) {
+        auto target = m_kb->symbols()->find(target_fact);
+        if (target == no_sym) { return print_reached(false); }
+
+        // Positions of producers which can be tried
+        std::vector<std::size_t> branches;
+        const auto &prods = m_kb->producers(target);
+        for (std::size_t pos = 0; pos < prods.size(); ++pos) {
+            if (!m_session.is_used(prods[pos])) { branches.push_back(pos); }
+        }
+        if (branches.size() < 2 || facts().contains(target) ||
+                m_session.goals().state(target) != goal_state_t::unknown ||
+                m_kb->slice(target).asks()) {
+            return print_reached(prove(target));
         }
 
-        return result;
+        return print_reached(speculate(target, branches, pool));
     }
 
     /**
-     * @brief Launch the expert system with the direct output
+     * @brief Launch the expert system with the direct output. If the target
+     *        is set, only rules which can contribute to it are activated
      * @param target_fact The target fact (`nullptr` to run for any target)
      * @return True if the target was achieved
      */
     bool direct(const val_t *target_fact = nullptr) {
-        while (!m_cur_rules.empty()) {
-            auto it = m_cur_rules.begin();
-            auto old_size = m_cur_rules.size();
-            bool is_target = false;
-            for (; it < m_cur_rules.end(); ++it) {
-                is_target = false;
-                if ((*it)->is(m_facts) > 0) {
-                    if (!handle_rule(*it)) { return false; }
-                    is_target = (*it)->target();
+        if (m_direct_mode == direct_mode_t::incremental) {
+            return direct_incremental(target_fact);
+        }
+        if (m_direct_mode == direct_mode_t::rete) {
+            return direct_rete(target_fact);
+        }
+        if (m_direct_mode == direct_mode_t::stratified) {
+            return direct_stratified(target_fact);
+        }
+        if (m_direct_mode == direct_mode_t::magic) {
+            return direct_magic(target_fact);
+        }
 
-                    m_cur_rules.erase(it);
+        auto target = target_fact ? m_kb->symbols()->find(*target_fact)
+                                  : no_sym;
+        auto rules = m_kb->rules();
+        auto slice = target_fact ? &m_kb->slice(target) : nullptr;
+        auto count = slice ? slice->rules().size() : rules->size();
+        // The fact derived last, it can be known already
+        auto last = no_sym;
+        while (m_session.used().size() < rules->size()) {
+            auto old_size = m_session.used().size();
+            bool is_target = false;
+            for (std::size_t i = 0; i < count; ++i) {
+                auto idx = slice ? slice->rules()[i] : i;
+                auto rule = (*rules)[idx].get();
+                if (m_session.is_used(idx) || !m_session.is(idx)) {
+                    continue;
                 }
+                last = handle_rule(rule);
+                if (last == no_sym) { return false; }
+                m_session.use(idx);
+
+                is_target = rule->target();
                 if (is_target) { break; }
             }
             if (is_target && !target_fact) {
-                m_dialog.print() << "Result: " << m_facts.back()
-                                 << std::endl;
+                m_dialog.print() << "Result: " << value(last) << std::endl;
                 return true;
-            } else if (*target_fact == m_facts.back()) {
+            } else if (target != no_sym && target == last) {
                 m_dialog.print() << "Target was found!" << std::endl;
                 return true;
             }
-            if (old_size == m_cur_rules.size()) {
-                if (target_fact) {
-                    m_dialog.print() << "Target wasn't reached" << std::endl;
-                } else {
-                    m_dialog.print() << "No reachable targets" << std::endl;
-                }
+            if (old_size == m_session.used().size()) {
+                print_unreached(target_fact);
                 return false;
             }
         }
@@ -121,115 +227,455 @@ public:
         return true;
     }
 
+    /**
+     * @brief Launch the expert system with the direct output which doesn't
+     *        stop at targets. Facts are saturated by the semi-naive
+     *        evaluation: every round uses all rules which are activated by
+     *        facts known before it, and the next round checks only rules
+     *        that mention facts added by this one. A rule with a negation
+     *        is checked again before its use, since facts added earlier in
+     *        the round can deactivate it
+     * @return Targets derived by target rules in the order of derivation
+     */
+    std::vector<val_t> saturate() { return saturate_impl(nullptr); }
+
+    /**
+     * @brief Saturates facts like `saturate()` does, but activating
+     *        expressions of a round are evaluated by the pool. Facts don't
+     *        change while a round is evaluated and activated rules are used
+     *        by the calling thread in the same order, so results, questions
+     *        and traces are the same
+     * @param pool Thread pool
+     * @return Targets derived by target rules in the order of derivation
+     */
+    std::vector<val_t> saturate(thread_pool_t &pool) {
+        return saturate_impl(&pool);
+    }
+
 private:
     /**
-     * @brief Handles the rule to get its output and update fact database
-     * @param rule Rule
-     * @return False if the rule is invalid
+     * @brief Saturates facts by the semi-naive evaluation
+     * @param pool Thread pool or `nullptr` to evaluate rules in this thread
+     * @return Targets derived by target rules in the order of derivation
      */
-    bool handle_rule(const rule_t<val_t> *rule) {
-        val_t fact;
+    std::vector<val_t> saturate_impl(thread_pool_t *pool) {
+        auto rules = m_kb->rules();
+        std::vector<val_t> targets;
+        bitmap_t is_target(m_kb->symbols()->size());
+        bitmap_t pending(rules->size(), true);
+        for (auto idx : m_session.used()) { pending.reset(idx); }
+
+        std::vector<std::size_t> round;
+        bool valid = true;
+        while (valid && pending.any()) {
+            round.clear();
+            for (auto idx = pending.next(0); idx != bitmap_t::npos;
+                 idx = pending.next(idx + 1)) {
+                pending.reset(idx);
+                round.push_back(idx);
+            }
+            activate(round, pool);
+
+            auto delta = facts().size();
+            for (auto idx : round) {
+                auto rule = (*rules)[idx].get();
+                if (facts().size() != delta && rule->program().negative() &&
+                        !m_session.is(idx)) {
+                    continue;
+                }
+                auto fact = handle_rule(rule);
+                if (fact == no_sym) {
+                    valid = false;
+                    break;
+                }
+                m_session.use(idx);
 
-        if (rule->question()) {
-            fact = m_dialog.ask(rule->question());
-        } else if (rule->out()) {
-            fact = *rule->out();
-        } else {
-            m_dialog.print() << "Rule `" << rule->id()
-                              << "` doesn't consist question or output"
-                              << std::endl;
+                if (rule->target() && !is_target.test(fact)) {
+                    is_target.set(fact);
+                    targets.push_back(value(fact));
+                }
+            }
+            for (auto it = facts().begin() + delta; it != facts().end();
+                 ++it) {
+                for (auto w : m_kb->watchers(*it)) {
+                    if (!m_session.is_used(w)) { pending.set(w); }
+                }
+            }
+        }
 
-            return false;
+        for (const auto &target : targets) {
+            m_dialog.print() << "Result: " << target << std::endl;
         }
+        if (targets.empty()) { print_unreached(nullptr); }
 
-        m_tracer.push_rule(rule, fact);
-        m_tracer.push_fact(fact);
+        return targets;
+    }
 
-        m_facts.push_back(fact);
+    /**
+     * @brief Keeps activated rules of the round in their order. Workers of
+     *        the pool evaluate chunks of a large round over the same facts,
+     *        a small round is evaluated with the cache of the session
+     * @param round Rule indexes
+     * @param pool Thread pool or `nullptr`
+     */
+    void activate(std::vector<std::size_t> &round, thread_pool_t *pool) {
+        auto chunks = pool ? std::min(pool->size() * 4,
+                                      round.size() / min_chunk) : 0;
+        if (chunks < 2) {
+            round.erase(std::remove_if(round.begin(), round.end(),
+                                       [this] (std::size_t idx) {
+                return !m_session.is(idx);
+            }), round.end());
+            return;
+        }
 
-        return true;
+        auto rules = m_kb->rules();
+        const auto &fb = facts();
+        std::vector<std::uint8_t> active(round.size());
+        pool->parallel_for(chunks, [&] (std::size_t chunk) {
+            auto end = round.size() * (chunk + 1) / chunks;
+            for (auto i = round.size() * chunk / chunks; i < end; ++i) {
+                active[i] = (*rules)[round[i]]->is(fb);
+            }
+        });
+
+        std::size_t size = 0;
+        for (std::size_t i = 0; i < round.size(); ++i) {
+            if (active[i]) { round[size++] = round[i]; }
+        }
+        round.resize(size);
     }
 
-    bool reverse_impl(const val_t tgt_fact) {
-        for (auto i = m_cur_rules.begin(); i < m_cur_rules.end(); ++i) {
-            auto rule = *i;
-            if ((*i)->is_possible_out(tgt_fact) && check_output(*i, tgt_fact)) {
-                m_cur_rules.erase(i);
-                return prove_rule(rule, tgt_fact);
+    /**
+     * @brief The direct output which rechecks a rule only when a fact its
+     *        expression mentions was added
+     * @param target_fact The target fact (`nullptr` to run for any target)
+     * @param members Rules to check, the slice of the target by default
+     * @return True if the target was achieved
+     */
+    bool direct_incremental(const val_t *target_fact,
+                            const bitmap_t *members = nullptr) {
+        auto target = target_fact ? m_kb->symbols()->find(*target_fact)
+                                  : no_sym;
+        auto rules = m_kb->rules();
+        if (!members && target_fact) {
+            members = &m_kb->slice(target).members();
+        }
+        bitmap_t pending = members ? *members : bitmap_t(rules->size(), true);
+        for (auto idx : m_session.used()) { pending.reset(idx); }
+
+        bool result = false;
+        auto idx = pending.next(0);
+        while (idx != bitmap_t::npos) {
+            pending.reset(idx);
+            auto rule = (*rules)[idx].get();
+            if (m_session.is(idx)) {
+                auto old_size = facts().size();
+                auto fact = handle_rule(rule);
+                if (fact == no_sym) { break; }
+                m_session.use(idx);
+
+                if (rule->target() && !target_fact) {
+                    m_dialog.print() << "Result: " << value(fact)
+                                     << std::endl;
+                    result = true;
+                    break;
+                }
+                if (target != no_sym && target == fact) {
+                    m_dialog.print() << "Target was found!" << std::endl;
+                    result = true;
+                    break;
+                }
+                // A known fact doesn't change values of expressions
+                if (facts().size() != old_size) {
+                    for (auto w : m_kb->watchers(fact)) {
+                        if (!m_session.is_used(w) &&
+                                (!members || members->test(w))) {
+                            pending.set(w);
+                        }
+                    }
+                }
             }
+            // Rules activated before the current one are checked in the
+            // next pass like the scan strategy does
+            idx = pending.next(idx + 1);
+            if (idx == bitmap_t::npos) { idx = pending.next(0); }
         }
 
-        return false;
+        if (idx == bitmap_t::npos) { print_unreached(target_fact); }
+
+        return result;
     }
 
     /**
-     * @brief Check if activation conditions of the rule are true
-     * @param rule Rule
-     * @param target_fact Target fact (it will be accepted as true fact if the
-     *                    conditions are true)
-     * @return Check result
+     * @brief The direct output which takes activated rules from the agenda
+     *        of the discrimination network
+     * @param target_fact The target fact (`nullptr` to run for any target)
+     * @return True if the target was achieved
      */
-    bool check_rule(const rule_t<val_t> *rule, val_t target_fact) {
-        if (rule->is(m_facts) > 0) {
-            m_facts.push_back(target_fact);
-            m_tracer.push_fact(target_fact);
+    bool direct_rete(const val_t *target_fact) {
+        matcher_t<val_t> matcher(m_kb, m_session, m_tracer, m_dialog.print());
+        auto quest = matcher.match(target_fact);
+        while (quest) { quest = matcher.answer(m_dialog.ask(quest)); }
 
-            return true;
+        return matcher.result();
+    }
+
+    /**
+     * @brief The direct output over the magic set rewriting of rules for the
+     *        target: the target is demanded, producers of a demanded fact are
+     *        demanded and so are unknown facts they mention. Known facts
+     *        aren't demanded, so rules which lead only to them are skipped
+     *        unlike rules of the slice. A known target is found when a rule
+     *        derives it again, so all rules of its slice are checked
+     * @param target_fact The target fact (`nullptr` to run for any target)
+     * @return True if the target was achieved
+     */
+    bool direct_magic(const val_t *target_fact) {
+        if (!target_fact) { return direct_incremental(target_fact); }
+
+        auto target = m_kb->symbols()->find(*target_fact);
+        if (target != no_sym && facts().contains(target)) {
+            return direct_incremental(target_fact);
         }
 
-        return false;
+        auto rules = m_kb->rules();
+        bitmap_t demanded(rules->size());
+        if (target != no_sym) {
+            bitmap_t seen(m_kb->symbols()->size());
+            std::vector<sym_t> goals{target};
+            vals_t<sym_t> mentioned;
+            seen.set(target);
+            while (!goals.empty()) {
+                auto goal = goals.back();
+                goals.pop_back();
+                for (auto idx : m_kb->producers(goal)) {
+                    if (demanded.test(idx) || m_session.is_used(idx)) {
+                        continue;
+                    }
+                    demanded.set(idx);
+                    mentioned.clear();
+                    (*rules)[idx]->facts(mentioned);
+                    for (auto fact : mentioned) {
+                        if (seen.test(fact) || facts().contains(fact)) {
+                            continue;
+                        }
+                        seen.set(fact);
+                        goals.push_back(fact);
+                    }
+                }
+            }
+        }
+
+        return direct_incremental(target_fact, &demanded);
     }
 
     /**
-     * @brief Try to prove that the target is a fact
-     * @param rule Rule that contains a required output
-     * @param target_fact Target (potential fact)
-     * @return True if the target was proved
+     * @brief The direct output which checks components of the dependency
+     *        graph after all components they depend on. So every negative
+     *        condition is checked after producers of its fact were tried,
+     *        unless they form a cycle
+     * @param target_fact The target fact (`nullptr` to run for any target)
+     * @return True if the target was achieved
      */
-    bool prove_rule(const rule_t<val_t> *rule, val_t target_fact) {
-        bool approved;
-        do {
-            approved = false;
-            auto uks = rule->unknowns(m_facts);
+    bool direct_stratified(const val_t *target_fact) {
+        auto target = target_fact ? m_kb->symbols()->find(*target_fact)
+                                  : no_sym;
+        auto rules = m_kb->rules();
+        auto slice = target_fact ? &m_kb->slice(target) : nullptr;
+        const auto &strata = slice ? slice->strata() : m_kb->strata();
+
+        for (std::size_t comp = 0; comp < strata.size(); ++comp) {
+            // Rules of later components can't activate rules of this one
+            bool changed;
+            do {
+                changed = false;
+                for (auto it = strata.begin(comp); it != strata.end(comp);
+                     ++it) {
+                    auto idx = *it;
+                    if (m_session.is_used(idx) || !m_session.is(idx)) {
+                        continue;
+                    }
+                    auto rule = (*rules)[idx].get();
+                    auto old_size = facts().size();
+                    auto fact = handle_rule(rule);
+                    if (fact == no_sym) { return false; }
+                    m_session.use(idx);
+
+                    if (rule->target() && !target_fact) {
+                        m_dialog.print() << "Result: " << value(fact)
+                                         << std::endl;
+                        return true;
+                    }
+                    if (target != no_sym && target == fact) {
+                        m_dialog.print() << "Target was found!" << std::endl;
+                        return true;
+                    }
+                    changed = changed || facts().size() != old_size;
+                }
+            } while (changed && strata.cyclic(comp));
+        }
 
-            if (uks.empty()) { return check_rule(rule, target_fact); }
+        print_unreached(target_fact);
 
-            for (auto u = uks.begin(); u != uks.end(); ++u) {
-                if (reverse_impl(*u)) {
-                    approved = true;
+        return false;
+    }
 
-                    break;
-                }
+    /**
+     * @brief Proves the goal by the reverse output
+     * @param target Interned goal
+     * @return True if the goal was proved
+     */
+    bool prove(sym_t target) {
+        prover_t<val_t> prover(m_kb, m_session, m_tracer, m_dialog.print());
+        prover.max_depth(m_max_depth);
+        auto quest = prover.prove(target);
+        while (quest) { quest = prover.answer(m_dialog.ask(quest)); }
+
+        return prover.result();
+    }
+
+    /**
+     * @brief Proves the goal by its producers in parallel
+     * @param target Interned goal
+     * @param branches Positions of producers
+     * @param pool Thread pool
+     * @return True if the goal was proved
+     */
+    bool speculate(sym_t target, const std::vector<std::size_t> &branches,
+                   thread_pool_t &pool) {
+        struct branch_t {
+            session_t<val_t> session;
+            trace_buffer_t<val_t> trace;
+            std::ostringstream out;
+            bool result = false;
+
+            explicit branch_t(session_t<val_t> &&session) :
+                session{std::move(session)} {}
+        };
+
+        // The first fork changes the session, so forks are made here
+        auto count = branches.size();
+        std::vector<std::unique_ptr<branch_t>> forks(count);
+        for (auto &fork : forks) {
+            fork = std::make_unique<branch_t>(m_session.fork());
+        }
+        std::unique_ptr<std::atomic<bool>[]> stop(
+                new std::atomic<bool>[count]{});
+        pool.parallel_for(count, [&] (std::size_t i) {
+            if (stop[i].load()) { return; }
+
+            auto &fork = *forks[i];
+            prover_t<val_t> prover(m_kb, fork.session, fork.trace, fork.out);
+            prover.max_depth(m_max_depth);
+            prover.stop_flag(&stop[i]);
+            prover.prove(target, branches[i]);
+            fork.result = prover.result();
+            if (fork.result) {
+                for (auto j = i + 1; j < count; ++j) { stop[j].store(true); }
             }
-        } while (approved);
+        });
 
-        return false;
+        for (auto &fork : forks) {
+            if (!fork->result) { continue; }
+
+            m_session = std::move(fork->session);
+            fork->trace.replay(m_tracer);
+            m_dialog.print() << fork->out.str();
+            return true;
+        }
+
+        // Branches don't see facts proved by each other unlike the serial
+        // proof, so it decides
+        return prove(target);
     }
 
     /**
-     * @brief Check if the rule will produce a required output fact
-     * @param rule Rule
-     * @param target_fact Target fact
-     * @return Check result
+     * @brief Reports the result of the reverse output
+     * @param result True if the target was achieved
+     * @return The result
      */
-    bool check_output(const rule_t<val_t> *rule, val_t target_fact) {
-        val_t fact;
+    bool print_reached(bool result) const {
+        if (result) {
+            m_dialog.print() << "Target is reachable!" << std::endl;
+        } else {
+            m_dialog.print() << "Target isn't reachable!" << std::endl;
+        }
 
-        if (rule->question()) {
-            fact = m_dialog.ask(rule->question());
-        } else if (rule->out()) {
-            fact = *rule->out();
+        return result;
+    }
+
+    /**
+     * @brief Reports that the direct output has no rules to activate
+     * @param target_fact The target fact (`nullptr` to run for any target)
+     */
+    void print_unreached(const val_t *target_fact) const {
+        if (target_fact) {
+            m_dialog.print() << "Target wasn't reached" << std::endl;
         } else {
+            m_dialog.print() << "No reachable targets" << std::endl;
+        }
+    }
+
+    /**
+     * @brief Returns facts of the session
+     */
+    fact_db_t &facts() { return m_session.facts(); }
+
+    /**
+     * @brief Returns a value of the interned fact
+     */
+    const val_t &value(sym_t fact) const {
+        return m_kb->symbols()->value(fact);
+    }
+
+    /**
+     * @brief Asks the question and interns the answer
+     * @param quest Question
+     * @return Interned answer or `no_sym` if the KB doesn't know it
+     */
+    sym_t ask(const quest_t<val_t> *quest) {
+        auto answer = m_dialog.ask(quest);
+        auto fact = m_kb->symbols()->find(answer);
+        if (fact == no_sym) {
+            m_dialog.print() << "Answer `" << answer << "` to question `"
+                             << quest->id() << "` is unknown" << std::endl;
+        }
+
+        return fact;
+    }
+
+    /**
+     * @brief Returns the output of the rule, it asks the question if any
+     * @param rule Rule
+     * @return Output fact or `no_sym` if the rule is invalid
+     */
+    sym_t output(const rule_t<val_t> *rule) {
+        if (rule->question()) { return ask(rule->question()); }
+        if (rule->out() == no_sym) {
             m_dialog.print() << "Rule `" << rule->id()
                              << "` doesn't consist question or output"
                              << std::endl;
-
-            return false;
         }
 
-        m_tracer.push_rule(rule, fact);
+        return rule->out();
+    }
+
+    /**
+     * @brief Handles the rule to get its output and update fact database
+     * @param rule Rule
+     * @return Output fact or `no_sym` if the rule is invalid
+     */
+    sym_t handle_rule(const rule_t<val_t> *rule) {
+        auto fact = output(rule);
+        if (fact == no_sym) { return no_sym; }
+
+        m_tracer.push_rule(rule, value(fact));
+        m_tracer.push_fact(value(fact));
+
+        facts().insert(fact);
 
-        return fact == target_fact;
+        return fact;
     }
 };
 
@@ -1,22 +1,51 @@
 #ifndef EXPRESSION_HPP
 #define EXPRESSION_HPP
 
+#include "arena.hpp"
+#include "fact_db.hpp"
+#include "symbols.hpp"
 #include "term.hpp"
 #include "unknown.hpp"
 
 #include <algorithm>
 #include <memory>
+#include <memory_resource>
 #include <vector>
 
 namespace xpertium {
 
 template <typename val_t> using vals_t = std::vector<val_t>;
 
+template <typename val_t> class exp_t;
+template <typename val_t> class fact_t;
+template <typename val_t> class not_t;
+template <typename val_t> class and_t;
+template <typename val_t> class or_t;
+
+/**
+ * This class must be a parent of all visitors of logical expressions
+ */
+template <typename val_t>
+class exp_visitor_t {
+public:
+    virtual ~exp_visitor_t() {}
+
+    /**
+     * @brief Visits an expression which is always true
+     */
+    virtual void visit(const exp_t<val_t> &exp) = 0;
+    virtual void visit(const fact_t<val_t> &exp) = 0;
+    virtual void visit(const not_t<val_t> &exp) = 0;
+    virtual void visit(const and_t<val_t> &exp) = 0;
+    virtual void visit(const or_t<val_t> &exp) = 0;
+};
+
 /**
- * This class must be a parent of all expression classes
+ * This class must be a parent of all expression classes. Expressions can be
+ * placed in an arena of the knowledge database
  */
 template <typename val_t>
-class exp_t {
+class exp_t: public arena_object_t {
 public:
     /**
      * @brief Constructor
@@ -58,15 +87,29 @@ public:
      * @param fb Fact database
      * @return Check result
      */
-    virtual double is(const vals_t<val_t> &fb) const { return 1; }
+    virtual double is(const fact_db_t &fb) const { return 1; }
 
     /**
      * @brief Returns required facts
      * @param fb Fact database
      * @return Required facts
      */
-    virtual unknowns_t<val_t> unknowns(const vals_t<val_t> &fb) const {
-        return unknowns_t<val_t>();
+    virtual unknowns_t<sym_t> unknowns(const fact_db_t &fb) const {
+        return unknowns_t<sym_t>();
+    }
+
+    /**
+     * @brief Collects all facts mentioned by the expression
+     * @param facts Output list (it can contain duplicates)
+     */
+    virtual void facts(vals_t<sym_t> &) const {}
+
+    /**
+     * @brief Accepts the visitor
+     * @param visitor Visitor
+     */
+    virtual void accept(exp_visitor_t<val_t> &visitor) const {
+        visitor.visit(*this);
     }
 };
 
@@ -75,15 +118,15 @@ public:
  */
 template <typename val_t>
 class fact_t: public exp_t<val_t> {
-    val_t m_value;
+    sym_t m_value;
     phase_t *m_phase;
 public:
     /**
      * @brief Constructor
-     * @param value Fact value
+     * @param value Interned fact value
      * @param phase Linked phase
      */
-    fact_t(val_t value, phase_t *phase = nullptr) :
+    fact_t(sym_t value, phase_t *phase = nullptr) :
         m_value{value}, m_phase{phase} {}
 
     /**
@@ -96,21 +139,40 @@ public:
      */
     fact_t<val_t> &operator=(fact_t &&) = default;
 
+    /**
+     * @brief Returns the interned fact value
+     */
+    sym_t value() const { return m_value; }
+
     /**
      * @inherits
      */
-    virtual double is(const vals_t<val_t> &fb) const override {
-        return std::find(fb.begin(), fb.end(), m_value) != fb.end() ? 1.0 : 0.0;
+    virtual double is(const fact_db_t &fb) const override {
+        return fb.contains(m_value) ? 1.0 : 0.0;
     }
 
     /**
      * @inherits
      */
-    virtual unknowns_t<val_t> unknowns(const vals_t<val_t> &fb) const override {
-        if (std::find(fb.begin(), fb.end(), m_value) != fb.end()) {
+    virtual unknowns_t<sym_t> unknowns(const fact_db_t &fb) const override {
+        if (fb.contains(m_value)) {
             return exp_t<val_t>::unknowns(fb);
         }
-        return unknowns_t<val_t>({unknown_t(true, m_value)});
+        return unknowns_t<sym_t>({unknown_t(true, m_value)});
+    }
+
+    /**
+     * @inherits
+     */
+    virtual void facts(vals_t<sym_t> &facts) const override {
+        facts.push_back(m_value);
+    }
+
+    /**
+     * @inherits
+     */
+    virtual void accept(exp_visitor_t<val_t> &visitor) const override {
+        visitor.visit(*this);
     }
 };
 
@@ -140,27 +202,46 @@ public:
         return *this;
     }
 
+    /**
+     * @brief Returns the nested logical expression
+     */
+    const exp_t<val_t> *exp() const { return m_exp.get(); }
+
     /**
      * @inherits
      */
-    virtual double is(const vals_t<val_t> &fb) const override {
+    virtual double is(const fact_db_t &fb) const override {
         return 1.0 - m_exp->is(fb);
     }
 
     /**
      * @inherits
      */
-    virtual unknowns_t<val_t> unknowns(const vals_t<val_t> &fb) const override {
+    virtual unknowns_t<sym_t> unknowns(const fact_db_t &fb) const override {
         auto uks = m_exp->unknowns(fb);
         for (auto it = uks.begin(); it != uks.end(); ++it) {
-            it->state != it->state;
+            it->state = !it->state;
         }
         return uks;
     }
+
+    /**
+     * @inherits
+     */
+    virtual void facts(vals_t<sym_t> &facts) const override {
+        m_exp->facts(facts);
+    }
+
+    /**
+     * @inherits
+     */
+    virtual void accept(exp_visitor_t<val_t> &visitor) const override {
+        visitor.visit(*this);
+    }
 };
 
 template <typename val_t>
-using exps_t = std::vector<std::unique_ptr<exp_t<val_t>>>;
+using exps_t = std::pmr::vector<std::unique_ptr<exp_t<val_t>>>;
 
 /**
  * This class represents the logical conjunction
@@ -173,8 +254,10 @@ public:
     /**
      * @brief Constructor
      * @param exps Nested logical expression
+     * @param arena Arena of the list of nested expressions (`nullptr` - heap)
      */
-    and_t(exps_t<val_t> &&exps) : exp_t<val_t>(), m_exps{std::move(exps)} {}
+    and_t(exps_t<val_t> &&exps, arena_t *arena = nullptr) :
+        exp_t<val_t>(), m_exps{std::move(exps), arena_resource(arena)} {}
 
     /**
      * Move constructor
@@ -186,10 +269,15 @@ public:
      */
     and_t<val_t> &operator=(and_t &&) = default;
 
+    /**
+     * @brief Returns nested logical expressions
+     */
+    const exps_t<val_t> &exps() const { return m_exps; }
+
     /**
      * @inherits
      */
-    virtual double is(const vals_t<val_t> &fb) const override {
+    virtual double is(const fact_db_t &fb) const override {
         for (const auto &exp : m_exps) {
             if (!exp->is(fb)) { return 0.0; }
         }
@@ -199,7 +287,7 @@ public:
     /**
      * @inherits
      */
-    virtual unknowns_t<val_t> unknowns(const vals_t<val_t> &fb) const override {
+    virtual unknowns_t<sym_t> unknowns(const fact_db_t &fb) const override {
         if(m_exps.empty()) { return exp_t<val_t>::unknowns(fb); }
 
         auto uks = (*m_exps.begin())->unknowns(fb);
@@ -212,6 +300,20 @@ public:
 
         return uks;
     }
+
+    /**
+     * @inherits
+     */
+    virtual void facts(vals_t<sym_t> &facts) const override {
+        for (const auto &exp : m_exps) { exp->facts(facts); }
+    }
+
+    /**
+     * @inherits
+     */
+    virtual void accept(exp_visitor_t<val_t> &visitor) const override {
+        visitor.visit(*this);
+    }
 };
 
 /**
@@ -223,8 +325,10 @@ public:
     /**
      * @brief Constructor
      * @param exps Nested logical expression
+     * @param arena Arena of the list of nested expressions (`nullptr` - heap)
      */
-    or_t(exps_t<val_t> &&exps) : and_t<val_t>{std::move(exps)} {}
+    or_t(exps_t<val_t> &&exps, arena_t *arena = nullptr) :
+        and_t<val_t>{std::move(exps), arena} {}
 
     /**
      * Move constructor
@@ -239,7 +343,14 @@ public:
     /**
      * @inherits
      */
-    virtual double is(const vals_t<val_t> &fb) const override {
+    virtual void accept(exp_visitor_t<val_t> &visitor) const override {
+        visitor.visit(*this);
+    }
+
+    /**
+     * @inherits
+     */
+    virtual double is(const fact_db_t &fb) const override {
         for (const auto &exp : this->m_exps) {
             if (exp->is(fb)) { return 1.0; }
         }
@@ -249,15 +360,15 @@ public:
     /**
      * @inherits
      */
-    virtual unknowns_t<val_t> unknowns(const vals_t<val_t> &fb) const override {
+    virtual unknowns_t<sym_t> unknowns(const fact_db_t &fb) const override {
         if(this->m_exps.empty()) { return exp_t<val_t>::unknowns(fb); }
 
-        auto uks = unknowns_t<val_t>();
+        auto uks = unknowns_t<sym_t>();
         for (auto it = this->m_exps.begin(); it < this->m_exps.end(); ++it) {
             auto tmp = (*it)->unknowns(fb);
             // If a reachable branch was found the fact database has enough
             // facts to the expression was true
-            if (tmp.empty()) { return unknowns_t<val_t>(); }
+            if (tmp.empty()) { return unknowns_t<sym_t>(); }
             // Plex branches into a single vector
             plex(uks, std::move(tmp));
         }
@@ -265,7 +376,7 @@ public:
         return uks;
     }
 private:
-    void plex(unknowns_t<val_t> &uks, const unknowns_t<val_t> &&branch) const {
+    void plex(unknowns_t<sym_t> &uks, const unknowns_t<sym_t> &&branch) const {
         for (auto i = branch.begin(); i != branch.end(); ++i) {
             auto j = std::find_if(uks.begin(), uks.end(), [i](auto obj) {
                 return obj.value == i->value;
@@ -282,41 +393,45 @@ private:
 template <typename val_t>
 /**
  * @brief Creates a new fact
- * @param v Fact value
+ * @param v Interned fact value
+ * @param arena Arena of the fact (`nullptr` - heap)
  * @return New fact
  */
-fact_t<val_t> *_fact(val_t &&v) {
-    return new fact_t<val_t>(std::move(v));
+fact_t<val_t> *_fact(sym_t v, arena_t *arena = nullptr) {
+    return new (arena) fact_t<val_t>(v);
 }
 
 template <typename val_t>
 /**
  * @brief Creates a new negation
  * @param exp Pointer of a nested logical expression
+ * @param arena Arena of the negation (`nullptr` - heap)
  * @return New negation
  */
-not_t<val_t> *_not(exp_t<val_t> *exp) {
-    return new not_t<val_t>(exp);
+not_t<val_t> *_not(exp_t<val_t> *exp, arena_t *arena = nullptr) {
+    return new (arena) not_t<val_t>(exp);
 }
 
 template <typename val_t>
 /**
  * @brief Creates a new conjunction
  * @param exps Nested logical expression
+ * @param arena Arena of the conjunction (`nullptr` - heap)
  * @return New conjunction
  */
-and_t<val_t> *_and(exps_t<val_t> &&exps) {
-    return new and_t<val_t>(std::move(exps));
+and_t<val_t> *_and(exps_t<val_t> &&exps, arena_t *arena = nullptr) {
+    return new (arena) and_t<val_t>(std::move(exps), arena);
 }
 
 template <typename val_t>
 /**
  * @brief Creates a new disjunction
  * @param exps Nested logical expression
+ * @param arena Arena of the disjunction (`nullptr` - heap)
  * @return New disjunction
  */
-or_t<val_t> *_or(exps_t<val_t> &&exps) {
-    return new or_t<val_t>(std::move(exps));
+or_t<val_t> *_or(exps_t<val_t> &&exps, arena_t *arena = nullptr) {
+    return new (arena) or_t<val_t>(std::move(exps), arena);
 }
 
 }
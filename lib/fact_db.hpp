@@ -0,0 +1,158 @@
+#ifndef FACT_DB_HPP
+#define FACT_DB_HPP
+
+#include "cow.hpp"
+#include "symbols.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+namespace xpertium {
+
+/**
+ * This class represents a set of dense IDs. It keeps a bitset for O(1)
+ * membership checks and a log of IDs in the insertion order. Both are flat
+ * until the set is forked, forks share pages until one of them changes
+ */
+class id_set_t {
+    cow_array_t<std::uint64_t, 64> m_bits;
+    cow_array_t<sym_t, 1024> m_log;
+public:
+    /**
+     * This class iterates over the insertion log
+     */
+    class const_iterator {
+        const cow_array_t<sym_t, 1024> *m_log;
+        std::size_t m_idx;
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = sym_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const sym_t *;
+        using reference = const sym_t &;
+
+        const_iterator(const cow_array_t<sym_t, 1024> *log, std::size_t idx) :
+            m_log{log}, m_idx{idx} {}
+
+        reference operator*() const { return (*m_log)[m_idx]; }
+        const_iterator &operator++() { ++m_idx; return *this; }
+        const_iterator operator+(difference_type n) const {
+            return {m_log, m_idx + n};
+        }
+        difference_type operator-(const const_iterator &other) const {
+            return m_idx - other.m_idx;
+        }
+        bool operator==(const const_iterator &other) const {
+            return m_idx == other.m_idx;
+        }
+        bool operator!=(const const_iterator &other) const {
+            return m_idx != other.m_idx;
+        }
+    };
+
+    /**
+     * @brief Constructor
+     * @param capacity Expected number of different IDs
+     */
+    explicit id_set_t(std::size_t capacity = 0) :
+        m_bits((capacity + 63) / 64) {}
+
+    id_set_t(const id_set_t &) = default;
+    id_set_t(id_set_t &&) = default;
+
+    id_set_t &operator=(const id_set_t &) = default;
+    id_set_t &operator=(id_set_t &&) = default;
+
+    /**
+     * @brief Returns a set which shares IDs with this one. The first fork
+     *        moves both sets to pages in O(size), later forks cost O(1)
+     */
+    id_set_t fork() {
+        id_set_t res;
+        res.m_bits = m_bits.fork();
+        res.m_log = m_log.fork();
+        return res;
+    }
+
+    /**
+     * @brief Checks if the set contains the ID
+     * @param id ID
+     * @return Check result
+     */
+    bool contains(sym_t id) const {
+        auto word = id / 64;
+        return word < m_bits.size() &&
+                (m_bits[word] >> (id % 64) & 1);
+    }
+
+    /**
+     * @brief Adds the ID to the set
+     * @param id ID
+     * @return False if the set already contains the ID
+     */
+    bool insert(sym_t id) {
+        if (contains(id)) { return false; }
+
+        auto word = id / 64;
+        if (word >= m_bits.size()) { m_bits.resize(word + 1); }
+        m_bits.write(word) |= std::uint64_t(1) << (id % 64);
+        m_log.push_back(id);
+
+        return true;
+    }
+
+    /**
+     * @brief Removes all IDs, it costs O(size) and keeps the capacity. A
+     *        forked set releases its pages and becomes flat again
+     */
+    void clear() {
+        if (m_log.forked()) {
+            m_bits.clear();
+            m_log.clear();
+            return;
+        }
+
+        for (auto id : *this) { m_bits.write(id / 64) = 0; }
+        m_log.resize(0);
+    }
+
+    /**
+     * @brief Returns `true` if the set is empty
+     */
+    bool empty() const { return m_log.empty(); }
+
+    /**
+     * @brief Returns a number of IDs
+     */
+    std::size_t size() const { return m_log.size(); }
+
+    /**
+     * @brief Returns the last added ID
+     */
+    sym_t back() const { return m_log.back(); }
+
+    /**
+     * @brief Returns an ID by its insertion index
+     */
+    sym_t operator[](std::size_t idx) const { return m_log[idx]; }
+
+    /**
+     * @brief Returns the begin of the insertion log
+     */
+    const_iterator begin() const { return {&m_log, 0}; }
+
+    /**
+     * @brief Returns the end of the insertion log
+     */
+    const_iterator end() const { return {&m_log, m_log.size()}; }
+};
+
+/**
+ * Fact database: the set of interned facts known in a session
+ */
+using fact_db_t = id_set_t;
+
+}
+
+#endif // FACT_DB_HPP
@@ -0,0 +1,132 @@
+#ifndef GOAL_HPP
+#define GOAL_HPP
+
+#include "cow.hpp"
+#include "symbols.hpp"
+
+#include <cstdint>
+
+namespace xpertium {
+
+/**
+ * States of goals of the reverse output
+ */
+enum class goal_state_t : std::uint8_t {
+    unknown, ///< The goal wasn't tried or its result wasn't memoized
+    proving, ///< The goal is being proved (it's on the proof stack)
+    proven,  ///< The goal is a fact
+    failed   ///< The goal can't be proved
+};
+
+/**
+ * Frame of the explicit proof stack of the reverse output. A goal frame
+ * tries rules which produce its goal, a rule frame proves facts required by
+ * its rule
+ */
+struct proof_frame_t {
+    /**
+     * Points where the frame continues
+     */
+    enum class stage_t : std::uint8_t {
+        goal,      ///< The goal frame isn't started
+        producers, ///< The goal frame tries the next producer
+        asked,     ///< The goal frame waits for an answer of the producer
+        proved,    ///< The goal frame waits for the proof of the producer
+        rule,      ///< The rule frame isn't started
+        unknowns,  ///< The rule frame collects required facts
+        required,  ///< The rule frame tries the next required fact
+        reproved   ///< The rule frame waits for the proof of the fact
+    };
+
+    stage_t stage;
+    sym_t goal;               ///< Goal or the fact produced by the rule
+    std::uint32_t depth = 0;  ///< Depth of the goal on the stack
+    std::uint32_t outer = 0;  ///< Cycle depth of the enclosing goal
+    std::size_t rule = 0;     ///< Index of the rule of a rule frame
+    std::size_t pos = 0;      ///< Next producer or required fact
+    std::size_t begin = 0;    ///< First required fact of the rule frame
+    std::size_t end = 0;      ///< End of producers or required facts
+};
+
+/**
+ * This class memoizes goals of the reverse output for a single session. Its
+ * arrays are flat until the table is forked with the session
+ */
+class goal_table_t {
+    struct entry_t {
+        goal_state_t state = goal_state_t::unknown;
+        std::uint32_t depth = 0;
+    };
+
+    cow_array_t<entry_t, 512> m_entries;
+    cow_array_t<sym_t, 1024> m_touched;
+public:
+    /**
+     * @brief Constructor
+     * @param capacity Number of interned facts
+     */
+    explicit goal_table_t(std::size_t capacity = 0) : m_entries(capacity) {}
+
+    goal_table_t(const goal_table_t &) = default;
+    goal_table_t(goal_table_t &&) = default;
+
+    goal_table_t &operator=(const goal_table_t &) = default;
+    goal_table_t &operator=(goal_table_t &&) = default;
+
+    /**
+     * @brief Returns a table which shares goals with this one
+     */
+    goal_table_t fork() {
+        goal_table_t res;
+        res.m_entries = m_entries.fork();
+        res.m_touched = m_touched.fork();
+        return res;
+    }
+
+    /**
+     * @brief Returns a state of the goal
+     */
+    goal_state_t state(sym_t goal) const {
+        return goal < m_entries.size() ? m_entries[goal].state
+                                       : goal_state_t::unknown;
+    }
+
+    /**
+     * @brief Returns a depth of the proof stack where the goal is proved
+     */
+    std::uint32_t depth(sym_t goal) const { return m_entries[goal].depth; }
+
+    /**
+     * @brief Updates the goal
+     * @param goal Goal
+     * @param state New state
+     * @param depth Depth of the proof stack
+     */
+    void set(sym_t goal, goal_state_t state, std::uint32_t depth = 0) {
+        if (goal >= m_entries.size()) { m_entries.resize(goal + 1); }
+        if (m_entries[goal].state == goal_state_t::unknown) {
+            m_touched.push_back(goal);
+        }
+        m_entries.write(goal) = {state, depth};
+    }
+
+    /**
+     * @brief Forgets all goals, it costs O(number of updated goals)
+     */
+    void clear() {
+        if (m_touched.forked()) {
+            m_entries.clear();
+            m_touched.clear();
+            return;
+        }
+
+        for (std::size_t i = 0; i < m_touched.size(); ++i) {
+            m_entries.write(m_touched[i]) = entry_t();
+        }
+        m_touched.resize(0);
+    }
+};
+
+}
+
+#endif // GOAL_HPP
@@ -0,0 +1,326 @@
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include "kb.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace xpertium {
+
+/**
+ * Version of the binary KB image, it's changed on every format change
+ */
+constexpr std::uint32_t image_version = 1;
+
+/**
+ * Header of the binary KB image. It's followed by sections of 32-bit words:
+ * offsets of strings (`strings + 1`), symbols, questions (4 words each),
+ * answers (3 words each), rules (6 words each), instructions (`instr_t`) and
+ * characters of strings. All references are indexes, so the image can be
+ * mapped at any address
+ */
+struct image_header_t {
+    char magic[4];       ///< "XPKB"
+    std::uint32_t version;
+    std::uint32_t order; ///< 0x01020304 in the byte order of the writer
+    std::uint32_t name;  ///< String index of the KB name
+    std::uint32_t strings;
+    std::uint32_t symbols;
+    std::uint32_t quests;
+    std::uint32_t answers;
+    std::uint32_t rules;
+    std::uint32_t code;
+    std::uint32_t chars;
+};
+
+/**
+ * This class maps a file into memory for reading
+ */
+class mapped_file_t {
+    void *m_data = MAP_FAILED;
+    std::size_t m_size = 0;
+public:
+    /**
+     * @brief Constructor
+     * @param filename Path of the file
+     */
+    explicit mapped_file_t(const std::string &filename) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) { return; }
+
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            m_size = static_cast<std::size_t>(st.st_size);
+            m_data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+    }
+
+    /**
+     * @brief Deletes a copy constructor
+     */
+    mapped_file_t(const mapped_file_t &) = delete;
+
+    /**
+     * @brief Deletes a copy assignment
+     */
+    mapped_file_t &operator=(const mapped_file_t &) = delete;
+
+    ~mapped_file_t() { if (valid()) { ::munmap(m_data, m_size); } }
+
+    /**
+     * @brief Returns `true` if the file is mapped
+     */
+    bool valid() const { return m_data != MAP_FAILED; }
+
+    /**
+     * @brief Returns mapped bytes
+     */
+    const char *data() const { return static_cast<const char *>(m_data); }
+
+    /**
+     * @brief Returns a number of mapped bytes
+     */
+    std::size_t size() const { return m_size; }
+};
+
+namespace internal {
+
+/**
+ * This class collects sections of the image
+ */
+class image_writer_t {
+    std::unordered_map<std::string, std::uint32_t> m_ids;
+    std::vector<std::uint32_t> m_offs{0};
+    std::string m_chars;
+public:
+    std::vector<std::uint32_t> symbols, quests, answers, rules;
+    std::vector<instr_t> code;
+
+    std::uint32_t string(const std::string &str) {
+        auto res = m_ids.emplace(str, static_cast<std::uint32_t>(
+                                     m_offs.size() - 1));
+        if (res.second) {
+            m_chars += str;
+            m_offs.push_back(static_cast<std::uint32_t>(m_chars.size()));
+        }
+        return res.first->second;
+    }
+
+    bool write(const std::string &filename, std::uint32_t name) const {
+        image_header_t header{{'X', 'P', 'K', 'B'}, image_version, 0x01020304,
+                              name,
+                              static_cast<std::uint32_t>(m_offs.size() - 1),
+                              static_cast<std::uint32_t>(symbols.size()),
+                              static_cast<std::uint32_t>(quests.size() / 4),
+                              static_cast<std::uint32_t>(answers.size() / 3),
+                              static_cast<std::uint32_t>(rules.size() / 6),
+                              static_cast<std::uint32_t>(code.size()),
+                              static_cast<std::uint32_t>(m_chars.size())};
+
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        write(out, &header, 1);
+        for (const auto *section : {&m_offs, &symbols, &quests, &answers,
+                                    &rules}) {
+            write(out, section->data(), section->size());
+        }
+        write(out, code.data(), code.size());
+        write(out, m_chars.data(), m_chars.size());
+
+        return static_cast<bool>(out.flush());
+    }
+private:
+    template <typename obj_t>
+    static void write(std::ofstream &out, const obj_t *objs, std::size_t n) {
+        out.write(reinterpret_cast<const char *>(objs),
+                  static_cast<std::streamsize>(n * sizeof(obj_t)));
+    }
+};
+
+/**
+ * This class reads sections of the mapped image and checks their bounds
+ */
+class image_reader_t {
+    const char *m_data;
+    std::size_t m_size;
+    std::size_t m_pos = sizeof(image_header_t);
+public:
+    image_reader_t(const char *data, std::size_t size) :
+        m_data{data}, m_size{size} {}
+
+    /**
+     * @brief Returns the next section of `n` objects or `nullptr` if the
+     *        image is too short
+     */
+    template <typename obj_t>
+    const obj_t *section(std::size_t n) {
+        if (n > (m_size - m_pos) / sizeof(obj_t)) { return nullptr; }
+        auto res = reinterpret_cast<const obj_t *>(m_data + m_pos);
+        m_pos += n * sizeof(obj_t);
+        return res;
+    }
+};
+
+}
+
+/**
+ * @brief Compiles the knowledge database into a binary image
+ * @param kb Knowledge database
+ * @param filename Path of the image
+ * @return False if the image can't be written
+ */
+inline bool save_image(const kb_t<std::string> &kb,
+                       const std::string &filename) {
+    internal::image_writer_t writer;
+    auto name = writer.string(kb.name());
+
+    auto symbols = kb.symbols();
+    for (std::size_t sym = 0; sym < symbols->size(); ++sym) {
+        writer.symbols.push_back(writer.string(
+                                     symbols->value(static_cast<sym_t>(sym))));
+    }
+
+    std::unordered_map<const quest_t<std::string> *, std::uint32_t> quests;
+    for (const auto &quest : *kb.questions()) {
+        quests.emplace(quest.get(), static_cast<std::uint32_t>(quests.size()));
+        writer.quests.insert(writer.quests.end(), {
+            writer.string(quest->id()), writer.string(quest->question()),
+            static_cast<std::uint32_t>(writer.answers.size() / 3),
+            static_cast<std::uint32_t>(quest->answers().size())});
+        for (const auto &ans : quest->answers()) {
+            writer.answers.insert(writer.answers.end(), {
+                writer.string(ans.id()), writer.string(ans.title()),
+                ans.fact()});
+        }
+    }
+
+    for (const auto &rule : *kb.rules()) {
+        const auto &prog = rule->program();
+        writer.rules.insert(writer.rules.end(), {
+            writer.string(rule->id()),
+            rule->question() ? quests[rule->question()] : no_sym,
+            rule->target(), rule->out(),
+            static_cast<std::uint32_t>(writer.code.size()),
+            static_cast<std::uint32_t>(prog.size())});
+        for (std::size_t ip = 0; ip < prog.size(); ++ip) {
+            // Padding of instructions is zeroed to keep images reproducible
+            instr_t in;
+            std::memset(&in, 0, sizeof(in));
+            in.op = prog.code()[ip].op;
+            in.arg = prog.code()[ip].arg;
+            writer.code.push_back(in);
+        }
+    }
+
+    return writer.write(filename, name);
+}
+
+/**
+ * @brief Loads the knowledge database from a binary image. Programs of rules
+ *        refer to the mapped image, so its pages are shared by processes
+ *        which load the same image
+ * @param filename Path of the image
+ * @param kb Output knowledge database
+ * @return False if the image can't be read or it's malformed
+ */
+inline bool load_image(const std::string &filename, kb_t<std::string> **kb) {
+    auto file = std::make_shared<mapped_file_t>(filename);
+    if (!file->valid() || file->size() < sizeof(image_header_t)) {
+        return false;
+    }
+
+    const auto &hdr = *reinterpret_cast<const image_header_t *>(file->data());
+    if (std::memcmp(hdr.magic, "XPKB", 4) != 0 ||
+            hdr.version != image_version || hdr.order != 0x01020304) {
+        return false;
+    }
+
+    internal::image_reader_t reader(file->data(), file->size());
+    auto offs = reader.section<std::uint32_t>(std::size_t(hdr.strings) + 1);
+    auto syms = reader.section<std::uint32_t>(hdr.symbols);
+    auto qs = reader.section<std::uint32_t>(std::size_t(hdr.quests) * 4);
+    auto as = reader.section<std::uint32_t>(std::size_t(hdr.answers) * 3);
+    auto rs = reader.section<std::uint32_t>(std::size_t(hdr.rules) * 6);
+    auto code = reader.section<instr_t>(hdr.code);
+    auto chars = reader.section<char>(hdr.chars);
+    if (!offs || !syms || !qs || !as || !rs || !code || !chars) {
+        return false;
+    }
+    for (std::uint32_t i = 0; i < hdr.strings; ++i) {
+        if (offs[i] > offs[i + 1] || offs[i + 1] > hdr.chars) { return false; }
+    }
+
+    auto string = [&] (std::uint32_t idx) {
+        return std::string(chars + offs[idx], offs[idx + 1] - offs[idx]);
+    };
+    auto valid = [&] (std::uint32_t idx) { return idx < hdr.strings; };
+    if (!valid(hdr.name)) { return false; }
+
+    auto symbols = std::make_unique<symbols_t<std::string>>();
+    for (std::uint32_t sym = 0; sym < hdr.symbols; ++sym) {
+        if (!valid(syms[sym]) || symbols->intern(string(syms[sym])) != sym) {
+            return false;
+        }
+    }
+
+    auto quests = std::make_unique<quests_t<std::string>>();
+    for (auto q = qs; q != qs + std::size_t(hdr.quests) * 4; q += 4) {
+        if (!valid(q[0]) || !valid(q[1]) || q[2] > hdr.answers ||
+                q[3] > hdr.answers - q[2]) {
+            return false;
+        }
+        answers_t<std::string> answers;
+        for (auto a = as + std::size_t(q[2]) * 3;
+             a != as + std::size_t(q[2] + q[3]) * 3; a += 3) {
+            // An answer must give a fact, so `no_sym` is rejected too
+            if (!valid(a[0]) || !valid(a[1]) || a[2] >= hdr.symbols) {
+                return false;
+            }
+            answers.emplace_back(string(a[0]), string(a[1]), a[2]);
+        }
+        quests->push_back(std::make_unique<quest_t<std::string>>(
+                              string(q[0]), string(q[1]), std::move(answers)));
+    }
+
+    // Rules and their expressions are placed together, while programs stay
+    // in the image
+    auto arena = std::make_shared<arena_t>();
+    auto rules = std::make_unique<rules_t<std::string>>();
+    for (auto r = rs; r != rs + std::size_t(hdr.rules) * 6; r += 6) {
+        if (!valid(r[0]) || (r[1] != no_sym && r[1] >= hdr.quests) ||
+                (r[3] != no_sym && r[3] >= hdr.symbols) ||
+                r[4] > hdr.code || r[5] > hdr.code - r[4]) {
+            return false;
+        }
+        auto prog = program_t::view(code + r[4], r[5]);
+        auto exp = prog.decompile<std::string>(hdr.symbols, arena.get());
+        if (!exp) { return false; }
+
+        auto quest = r[1] != no_sym ? (*quests)[r[1]].get() : nullptr;
+        rules->emplace_back(new (arena.get()) rule_t<std::string>(
+                                string(r[0]), exp, std::move(prog), quest,
+                                r[2] != 0, r[3]));
+    }
+
+    *kb = new kb_t<std::string>(string(hdr.name));
+    (*kb)->load(symbols.release(), quests.release(), rules.release());
+    (*kb)->retain(std::move(file));
+    (*kb)->retain(std::move(arena));
+
+    return true;
+}
+
+}
+
+#endif // IMAGE_HPP
@@ -2,11 +2,20 @@
 #define KB_HPP
 
 #include "question.hpp"
+#include "rete.hpp"
 #include "rule.hpp"
+#include "slice.hpp"
+#include "strata.hpp"
+#include "symbols.hpp"
 #include "term.hpp"
 
+#include <algorithm>
+#include <functional>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace xpertium {
 
@@ -19,12 +28,60 @@ using rules_t = std::vector<std::unique_ptr<rule_t<val_t>>>;
 template <typename val_t>
 using terms_t = std::vector<std::unique_ptr<term_t<val_t>>>;
 
+/**
+ * This class finds objects of the knowledge database by their IDs. If IDs
+ * are repeated, the first object is found like a linear search would do
+ */
+template <typename obj_t>
+class id_index_t {
+    std::unordered_map<std::string, const obj_t *> m_objs;
+public:
+    /**
+     * @brief Constructor of an empty index
+     */
+    id_index_t() = default;
+
+    /**
+     * @brief Constructor
+     * @param objs Objects
+     * @param key Function which returns an ID of the object
+     */
+    template <typename key_t>
+    id_index_t(const std::vector<std::unique_ptr<obj_t>> &objs, key_t key) {
+        m_objs.reserve(objs.size());
+        for (const auto &obj : objs) {
+            m_objs.emplace(std::invoke(key, *obj), obj.get());
+        }
+    }
+
+    /**
+     * @brief Returns an object by ID
+     * @param id Object ID
+     * @return Pointer of object or `nullptr`
+     */
+    const obj_t *find(const std::string &id) const {
+        auto it = m_objs.find(id);
+        return it != m_objs.end() ? it->second : nullptr;
+    }
+};
+
 template <typename val_t>
 class kb_t {
+    // Storages of objects are destroyed after the objects placed in them
+    std::vector<std::shared_ptr<const void>> m_storage;
     std::string m_name;
+    std::unique_ptr<symbols_t<val_t>> m_symbols;
     std::unique_ptr<quests_t<val_t>> m_quests;
     std::unique_ptr<rules_t<val_t>> m_rules;
     std::unique_ptr<terms_t<val_t>> m_terms;
+    id_index_t<quest_t<val_t>> m_quest_ids;
+    id_index_t<rule_t<val_t>> m_rule_ids;
+    id_index_t<term_t<val_t>> m_term_ids;
+    std::vector<std::vector<std::size_t>> m_watchers;
+    std::vector<std::vector<std::size_t>> m_producers;
+    std::unique_ptr<rete_t<val_t>> m_rete;
+    strata_t m_strata;
+    std::unique_ptr<slice_cache_t> m_slices;
 public:
     /**
      * @brief Constructor
@@ -53,9 +110,38 @@ public:
     kb_t<val_t> &operator=(kb_t<val_t> &) = delete;
 
     /**
-     * @brief Move assignment
+     * @brief Move assignment. Members aren't assigned one by one, since the
+     *        old storage would be released before objects placed in it. The
+     *        old model is swapped into a temporary which destroys its
+     *        storage last
      */
-    kb_t<val_t> &operator=(kb_t &&) = default;
+    kb_t<val_t> &operator=(kb_t &&other) noexcept {
+        kb_t<val_t> tmp(std::move(other));
+        swap(tmp);
+        return *this;
+    }
+
+    /**
+     * @brief Swaps models of knowledge databases
+     * @param other Knowledge database
+     */
+    void swap(kb_t<val_t> &other) noexcept {
+        using std::swap;
+        swap(m_storage, other.m_storage);
+        swap(m_name, other.m_name);
+        swap(m_symbols, other.m_symbols);
+        swap(m_quests, other.m_quests);
+        swap(m_rules, other.m_rules);
+        swap(m_terms, other.m_terms);
+        swap(m_quest_ids, other.m_quest_ids);
+        swap(m_rule_ids, other.m_rule_ids);
+        swap(m_term_ids, other.m_term_ids);
+        swap(m_watchers, other.m_watchers);
+        swap(m_producers, other.m_producers);
+        swap(m_rete, other.m_rete);
+        swap(m_strata, other.m_strata);
+        swap(m_slices, other.m_slices);
+    }
 
     /**
      * @brief Returns a name of the knowledge database
@@ -67,13 +153,33 @@ public:
      * @param id Question ID
      * @return Pointer of question or `nullptr`
      */
-    const quest_t<val_t> *question(const std::string *id) const {
-        for (auto it = m_quests->begin(); it != m_quests->end(); ++it) {
-            if (it->id == (*id)) { return *it; }
-        }
-        return nullptr;
+    const quest_t<val_t> *question(const std::string &id) const {
+        return m_quest_ids.find(id);
+    }
+
+    /**
+     * @brief Returns a rule by ID
+     * @param id Rule ID
+     * @return Pointer of rule or `nullptr`
+     */
+    const rule_t<val_t> *rule(const std::string &id) const {
+        return m_rule_ids.find(id);
     }
 
+    /**
+     * @brief Returns a term by name
+     * @param name Term name
+     * @return Pointer of term or `nullptr`
+     */
+    const term_t<val_t> *term(const std::string &name) const {
+        return m_term_ids.find(name);
+    }
+
+    /**
+     * @brief Returns the symbol table of facts
+     */
+    const symbols_t<val_t> *symbols() const { return m_symbols.get(); }
+
     /**
      * @brief Returns questions
      */
@@ -89,17 +195,115 @@ public:
      */
     const terms_t<val_t> *terms() const { return m_terms.get(); }
 
+    /**
+     * @brief Returns rules whose activating expressions mention the fact
+     * @param fact Interned fact
+     * @return Rule indexes in ascending order
+     */
+    const std::vector<std::size_t> &watchers(sym_t fact) const {
+        return m_watchers[fact];
+    }
+
+    /**
+     * @brief Returns rules which can produce the fact by their outputs or
+     *        answers of their questions
+     * @param fact Interned fact
+     * @return Rule indexes in ascending order
+     */
+    const std::vector<std::size_t> &producers(sym_t fact) const {
+        return m_producers[fact];
+    }
+
+    /**
+     * @brief Returns the discrimination network compiled from rules
+     */
+    const rete_t<val_t> *rete() const { return m_rete.get(); }
+
+    /**
+     * @brief Returns rules ordered by components of their dependency graph
+     */
+    const strata_t &strata() const { return m_strata; }
+
+    /**
+     * @brief Returns rules which can contribute to the target. Slices are
+     *        built on the first request and shared by all sessions
+     * @param target Interned target fact
+     */
+    const slice_t &slice(sym_t target) const {
+        return m_slices->get(*this, target);
+    }
+
     /**
      * @brief Loads a production model
+     * @param symbols Symbol table used by questions and rules
      * @param quests Questions
      * @param rules Production rules
      * @param terms Terms
      */
-    void load(quests_t<val_t> *quests, rules_t<val_t> *rules,
-              terms_t<val_t> *terms = nullptr) {
+    void load(symbols_t<val_t> *symbols, quests_t<val_t> *quests,
+              rules_t<val_t> *rules, terms_t<val_t> *terms = nullptr) {
+        m_symbols = std::unique_ptr<symbols_t<val_t>>(symbols);
         m_quests = std::unique_ptr<quests_t<val_t>>(quests);
         m_rules = std::unique_ptr<rules_t<val_t>>(rules);
         m_terms = std::unique_ptr<terms_t<val_t>>(terms);
+        index_ids();
+        index_rules();
+        m_rete = std::make_unique<rete_t<val_t>>(*m_rules, m_symbols->size());
+        m_strata = strata_t(*this);
+        m_slices = std::make_unique<slice_cache_t>();
+    }
+
+    /**
+     * @brief Keeps memory which the loaded model refers to (e.g. a mapped
+     *        image or an arena of rules) until the knowledge database is
+     *        destroyed
+     * @param storage Owner of the memory
+     */
+    void retain(std::shared_ptr<const void> storage) {
+        m_storage.push_back(std::move(storage));
+    }
+private:
+    /**
+     * @brief Builds indexes from IDs to questions, rules and terms
+     */
+    void index_ids() {
+        m_quest_ids = {*m_quests, &quest_t<val_t>::id};
+        m_rule_ids = {*m_rules, &rule_t<val_t>::id};
+        m_term_ids = m_terms ? id_index_t<term_t<val_t>>{
+            *m_terms, &term_t<val_t>::name} : id_index_t<term_t<val_t>>{};
+    }
+
+    /**
+     * @brief Numbers rules and builds indexes from facts to rules
+     */
+    void index_rules() {
+        m_watchers.assign(m_symbols->size(), {});
+        m_producers.assign(m_symbols->size(), {});
+        vals_t<sym_t> facts;
+        for (std::size_t idx = 0; idx < m_rules->size(); ++idx) {
+            auto &rule = (*m_rules)[idx];
+            rule->m_index = idx;
+
+            facts.clear();
+            rule->facts(facts);
+            std::sort(facts.begin(), facts.end());
+            auto last = std::unique(facts.begin(), facts.end());
+            for (auto it = facts.begin(); it != last; ++it) {
+                m_watchers[*it].push_back(idx);
+            }
+
+            if (rule->out() != no_sym) { add_producer(rule->out(), idx); }
+            if (rule->question()) {
+                for (const auto &ans : rule->question()->answers()) {
+                    if (ans.fact() != no_sym) { add_producer(ans.fact(), idx); }
+                }
+            }
+        }
+    }
+
+    void add_producer(sym_t fact, std::size_t rule) {
+        auto &rules = m_producers[fact];
+        if (rules.empty() || rules.back() != rule) { rules.push_back(rule); }
     }
 };
 
@@ -0,0 +1,202 @@
+#ifndef MATCHER_HPP
+#define MATCHER_HPP
+
+#include "bitmap.hpp"
+#include "kb.hpp"
+#include "session.hpp"
+#include "tracer.hpp"
+
+#include <ostream>
+
+namespace xpertium {
+
+/**
+ * This class runs the direct output over the discrimination network of the
+ * knowledge database: activated rules are taken from the agenda of the
+ * session in ascending order and the agenda is rescanned from the first
+ * rule when its end is reached. It's the rete strategy of `expert_t` and the
+ * direct output of `async_expert_t`.
+ *
+ * The output is suspended on every question and resumed by `answer()`:
+ * `expert_t` answers from its dialogue and `async_expert_t` awaits the
+ * answer
+ */
+template <typename val_t>
+class matcher_t {
+    const kb_t<val_t> *m_kb;
+    session_t<val_t> &m_session;
+    base_tracer_t<val_t> &m_tracer;
+    std::ostream &m_out;
+    const slice_t *m_slice = nullptr;
+    const quest_t<val_t> *m_quest = nullptr;
+    sym_t m_target = no_sym;
+    std::size_t m_idx = bitmap_t::npos;
+    bool m_any = false;
+    bool m_done = true;
+    bool m_result = false;
+public:
+    /**
+     * @brief Constructor
+     * @param kb Knowledge database
+     * @param session Session which keeps facts and the agenda
+     * @param tracer Stack tracer
+     * @param out Stream for messages of the consultation
+     */
+    matcher_t(const kb_t<val_t> *kb, session_t<val_t> &session,
+              base_tracer_t<val_t> &tracer, std::ostream &out) :
+        m_kb{kb}, m_session{session}, m_tracer{tracer}, m_out{out} {}
+
+    /**
+     * @brief Starts the direct output. If the target is set, only rules
+     *        which can contribute to it are activated
+     * @param target_fact The target fact (`nullptr` to run for any target)
+     * @return The first question or `nullptr` if the output is done
+     */
+    const quest_t<val_t> *match(const val_t *target_fact) {
+        m_target = target_fact ? m_kb->symbols()->find(*target_fact)
+                               : no_sym;
+        m_any = !target_fact;
+        m_slice = target_fact ? &m_kb->slice(m_target) : nullptr;
+        m_quest = nullptr;
+        m_done = false;
+        m_result = false;
+
+        auto &rete = m_session.rete();
+        if (!rete.valid()) { rete.reset(); }
+        rete.sync(facts());
+        m_idx = next(0);
+
+        return run();
+    }
+
+    /**
+     * @brief Resumes the output with the answer to the current question
+     * @param answer Answer
+     * @return The next question or `nullptr` if the output is done
+     */
+    const quest_t<val_t> *answer(const val_t &answer) {
+        if (!m_quest) { return nullptr; }
+
+        auto fact = m_kb->symbols()->find(answer);
+        if (fact == no_sym) {
+            m_out << "Answer `" << answer << "` to question `"
+                  << m_quest->id() << "` is unknown" << std::endl;
+        }
+        m_quest = nullptr;
+
+        return use(fact) ? run() : nullptr;
+    }
+
+    /**
+     * @brief Returns the question the output waits for or `nullptr`
+     */
+    const quest_t<val_t> *question() const { return m_quest; }
+
+    /**
+     * @brief Returns `true` if the output is finished
+     */
+    bool done() const { return m_done; }
+
+    /**
+     * @brief Returns `true` if the finished output achieved the target
+     */
+    bool result() const { return m_done && m_result; }
+private:
+    fact_db_t &facts() { return m_session.facts(); }
+
+    const val_t &value(sym_t fact) const {
+        return m_kb->symbols()->value(fact);
+    }
+
+    /**
+     * @brief Returns the next activated rule of the slice
+     * @param from Start index
+     * @return Rule index or `bitmap_t::npos`
+     */
+    std::size_t next(std::size_t from) const {
+        auto &rete = m_session.rete();
+        auto idx = rete.next(from);
+        while (m_slice && idx != bitmap_t::npos &&
+               !m_slice->contains(idx)) {
+            idx = rete.next(idx + 1);
+        }
+
+        return idx;
+    }
+
+    /**
+     * @brief Takes the next activated rule after the current one
+     */
+    void advance() {
+        m_idx = next(m_idx + 1);
+        if (m_idx == bitmap_t::npos) { m_idx = next(0); }
+    }
+
+    /**
+     * @brief Uses activated rules until a question or the end of the output
+     */
+    const quest_t<val_t> *run() {
+        const auto &rules = *m_kb->rules();
+        while (m_idx != bitmap_t::npos) {
+            auto rule = rules[m_idx].get();
+            if (m_session.is_used(m_idx)) {
+                // The rule was used by the reverse output
+                m_session.rete().retire(m_idx);
+                advance();
+                continue;
+            }
+            if (rule->question()) {
+                m_quest = rule->question();
+                return m_quest;
+            }
+            if (rule->out() == no_sym) {
+                m_out << "Rule `" << rule->id()
+                      << "` doesn't consist question or output" << std::endl;
+            }
+            if (!use(rule->out())) { return nullptr; }
+        }
+
+        m_done = true;
+        if (m_any) { m_out << "No reachable targets" << std::endl; }
+        else { m_out << "Target wasn't reached" << std::endl; }
+
+        return nullptr;
+    }
+
+    /**
+     * @brief Uses the current rule and takes the next one
+     * @param fact Output of the rule
+     * @return False if the output is finished
+     */
+    bool use(sym_t fact) {
+        if (fact == no_sym) {
+            m_done = true;
+            return false;
+        }
+
+        auto rule = (*m_kb->rules())[m_idx].get();
+        m_tracer.push_rule(rule, value(fact));
+        m_tracer.push_fact(value(fact));
+        facts().insert(fact);
+        m_session.use(m_idx);
+        m_session.rete().retire(m_idx);
+
+        if (rule->target() && m_any) {
+            m_out << "Result: " << value(fact) << std::endl;
+        } else if (m_target != no_sym && m_target == fact) {
+            m_out << "Target was found!" << std::endl;
+        } else {
+            m_session.rete().sync(facts());
+            advance();
+            return true;
+        }
+
+        m_done = true;
+        m_result = true;
+        return false;
+    }
+};
+
+}
+
+#endif // MATCHER_HPP
@@ -0,0 +1,174 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xpertium {
+
+/**
+ * This class runs tasks on a fixed set of worker threads. Callers wait only
+ * for their own tasks, so any number of sessions can share a pool, and an
+ * exception of a task is passed to the caller which waits for it
+ */
+class thread_pool_t {
+    /**
+     * Calls of a single `parallel_for()`, they are claimed one by one by
+     * the caller and by helper tasks of workers
+     */
+    struct job_t {
+        std::function<void(std::size_t)> fn;
+        std::size_t size;
+        std::atomic<std::size_t> next{0};
+        std::mutex mutex;
+        std::condition_variable done;
+        std::size_t finished = 0;
+        std::exception_ptr error;
+
+        job_t(std::function<void(std::size_t)> fn, std::size_t size) :
+            fn{std::move(fn)}, size{size} {}
+
+        /**
+         * @brief Makes calls until all of them are claimed
+         */
+        void run() {
+            std::size_t count = 0;
+            std::exception_ptr first;
+            for (auto i = next++; i < size; i = next++) {
+                try { fn(i); } catch (...) {
+                    if (!first) { first = std::current_exception(); }
+                }
+                ++count;
+            }
+            if (!count) { return; }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (first && !error) { error = first; }
+            finished += count;
+            if (finished == size) { done.notify_all(); }
+        }
+    };
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    bool m_stop = false;
+public:
+    /**
+     * @brief Constructor
+     * @param threads Number of worker threads (0 - number of cores)
+     */
+    explicit thread_pool_t(std::size_t threads = 0) {
+        if (!threads) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (std::size_t i = 0; i < threads; ++i) {
+            m_threads.emplace_back([this] { work(); });
+        }
+    }
+
+    /**
+     * @brief Deletes a copy constructor
+     */
+    thread_pool_t(const thread_pool_t &) = delete;
+
+    /**
+     * @brief Deletes a copy assignment
+     */
+    thread_pool_t &operator=(const thread_pool_t &) = delete;
+
+    /**
+     * @brief Destructor, it finishes queued tasks and joins threads
+     */
+    ~thread_pool_t() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_ready.notify_all();
+        for (auto &thread : m_threads) { thread.join(); }
+    }
+
+    /**
+     * @brief Returns a number of worker threads
+     */
+    std::size_t size() const { return m_threads.size(); }
+
+    /**
+     * @brief Queues the task
+     * @param task Task
+     * @return Future which is ready when the task is finished, it keeps an
+     *         exception of the task
+     */
+    template <typename fn_t>
+    std::future<void> submit(fn_t task) {
+        auto packed = std::make_shared<std::packaged_task<void()>>(
+                std::move(task));
+        auto res = packed->get_future();
+        push([packed] { (*packed)(); });
+        return res;
+    }
+
+    /**
+     * @brief Runs `fn(i)` for every `i` in [0, n) and waits for them. The
+     *        calling thread makes calls too, so a task of the pool can call
+     *        it without waiting for busy workers
+     * @param n Number of calls
+     * @param fn Function
+     * @throw The first exception thrown by `fn` after all calls are done
+     */
+    template <typename fn_t>
+    void parallel_for(std::size_t n, fn_t fn) {
+        if (!n) { return; }
+
+        // Helpers which start late find no calls and don't touch `fn`
+        auto job = std::make_shared<job_t>(
+                [&fn] (std::size_t i) { fn(i); }, n);
+        auto helpers = std::min(n - 1, size());
+        for (std::size_t i = 0; i < helpers; ++i) {
+            push([job] { job->run(); });
+        }
+        job->run();
+
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->done.wait(lock, [&job] { return job->finished == job->size; });
+        if (job->error) { std::rethrow_exception(job->error); }
+    }
+private:
+    void push(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(std::move(task));
+        }
+        m_ready.notify_one();
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_ready.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+            if (m_tasks.empty()) { return; }
+
+            auto task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+};
+
+}
+
+#endif // POOL_HPP
@@ -0,0 +1,529 @@
+#ifndef PROGRAM_HPP
+#define PROGRAM_HPP
+
+#include "expression.hpp"
+#include "fact_db.hpp"
+#include "unknown.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace xpertium {
+
+/**
+ * Opcodes of compiled logical expressions
+ */
+enum class op_t : std::uint8_t {
+    fact,       ///< acc = the fact `arg` is known
+    no_fact,    ///< acc = the fact `arg` isn't known
+    neg,        ///< acc = !acc
+    jump_false, ///< if (!acc) goto `arg`
+    jump_true,  ///< if (acc) goto `arg`
+    conj,       ///< end of a conjunction with `arg` operands (0 - true)
+    disj        ///< end of a disjunction with `arg` operands (0 - false)
+};
+
+/**
+ * Instruction of a compiled logical expression
+ */
+struct instr_t {
+    op_t op;
+    std::uint32_t arg;
+};
+
+static_assert(sizeof(instr_t) == 8, "instructions are stored in KB images");
+
+/**
+ * This class keeps buffers of `program_t::unknowns` between calls, e.g. for
+ * a session of the reverse output
+ */
+class unknowns_scratch_t {
+    friend class program_t;
+
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    unknowns_t<sym_t> m_uks;
+    std::vector<std::size_t> m_segs;
+    std::vector<std::uint32_t> m_marks;
+    std::vector<std::size_t> m_pos;
+    std::uint32_t m_mark = 0;
+
+    /**
+     * @brief Forgets all marks
+     */
+    void next_mark() {
+        if (++m_mark == 0) {
+            std::fill(m_marks.begin(), m_marks.end(), 0);
+            m_mark = 1;
+        }
+    }
+
+    void mark(sym_t fact, std::size_t pos) {
+        if (fact >= m_marks.size()) {
+            m_marks.resize(fact + 1, 0);
+            m_pos.resize(fact + 1);
+        }
+        m_marks[fact] = m_mark;
+        m_pos[fact] = pos;
+    }
+
+    /**
+     * @brief Returns a position of the marked fact or `npos`
+     */
+    std::size_t find(sym_t fact) const {
+        return fact < m_marks.size() && m_marks[fact] == m_mark
+                ? m_pos[fact] : npos;
+    }
+};
+
+/**
+ * This class represents a logical expression lowered into a flat program.
+ * Operands are emitted in the postfix order, `conj`/`disj` close n-ary
+ * operations and jumps skip the rest of an operation as soon as its result
+ * is known. The program is evaluated by a single loop with an accumulator
+ * instead of virtual calls over a tree.
+ *
+ * A program either owns its instructions or refers to instructions stored
+ * elsewhere, e.g. in a mapped KB image
+ */
+class program_t {
+    std::vector<instr_t> m_code;
+    const instr_t *m_begin;
+    const instr_t *m_end;
+
+    template <typename val_t> class compiler_t;
+public:
+    /**
+     * @brief Constructor of an always true program
+     */
+    program_t() : m_code{{op_t::conj, 0}} { attach(); }
+
+    program_t(const program_t &other) : m_code{other.m_code} {
+        attach(other);
+    }
+
+    program_t(program_t &&) = default;
+
+    program_t &operator=(const program_t &other) {
+        if (this != &other) {
+            m_code = other.m_code;
+            attach(other);
+        }
+        return *this;
+    }
+
+    program_t &operator=(program_t &&) = default;
+
+    /**
+     * @brief Returns a program which refers to the instructions without
+     *        copying them, they must outlive the program
+     * @param code Instructions
+     * @param size Number of instructions
+     * @return Program
+     */
+    static program_t view(const instr_t *code, std::size_t size) {
+        program_t prog;
+        prog.m_code.clear();
+        prog.m_begin = code;
+        prog.m_end = code + size;
+        return prog;
+    }
+
+    /**
+     * @brief Compiles the logical expression
+     * @param exp Logical expression (`nullptr` is always true)
+     * @return Program
+     */
+    template <typename val_t>
+    static program_t compile(const exp_t<val_t> *exp);
+
+    /**
+     * @brief Restores an expression from the program
+     * @param symbols Number of interned facts
+     * @param arena Arena of the expression (`nullptr` - heap)
+     * @return Expression or `nullptr` if the program is malformed
+     */
+    template <typename val_t>
+    exp_t<val_t> *decompile(std::size_t symbols,
+                            arena_t *arena = nullptr) const;
+
+    /**
+     * @brief Replaces facts of the program, e.g. when it was compiled with
+     *        another symbol table
+     * @param ids New IDs of facts indexed by old ones
+     */
+    void remap(const std::vector<sym_t> &ids) {
+        if (m_code.empty()) { m_code.assign(m_begin, m_end); }
+        for (auto &in : m_code) {
+            if (in.op == op_t::fact || in.op == op_t::no_fact) {
+                in.arg = ids[in.arg];
+            }
+        }
+        attach();
+    }
+
+    /**
+     * @brief Moves instructions of the program into the arena, so programs
+     *        of a knowledge database are stored close to each other
+     * @param arena Arena which must outlive the program
+     */
+    void store(arena_t &arena) {
+        auto size = this->size();
+        auto code = static_cast<instr_t *>(
+            arena.allocate(size * sizeof(instr_t), alignof(instr_t)));
+        std::copy(m_begin, m_end, code);
+        *this = view(code, size);
+    }
+
+    /**
+     * @brief Returns instructions
+     */
+    const instr_t *code() const { return m_begin; }
+
+    /**
+     * @brief Returns a number of instructions
+     */
+    std::size_t size() const {
+        return static_cast<std::size_t>(m_end - m_begin);
+    }
+
+    /**
+     * @brief Checks if the expression has negations, so a new fact can make
+     *        it false
+     */
+    bool negative() const {
+        return std::any_of(m_begin, m_end, [] (const instr_t &in) {
+            return in.op == op_t::no_fact || in.op == op_t::neg;
+        });
+    }
+
+    /**
+     * @brief Checks if the expression is true
+     * @param fb Fact database
+     * @return Check result
+     */
+    bool is(const fact_db_t &fb) const {
+        auto code = m_begin;
+        bool acc = true;
+
+        for (auto ip = code; ip != m_end; ++ip) {
+            switch (ip->op) {
+            case op_t::fact: acc = fb.contains(ip->arg); break;
+            case op_t::no_fact: acc = !fb.contains(ip->arg); break;
+            case op_t::neg: acc = !acc; break;
+            case op_t::jump_false: if (!acc) { ip = code + ip->arg; } break;
+            case op_t::jump_true: if (acc) { ip = code + ip->arg; } break;
+            case op_t::conj: if (!ip->arg) { acc = true; } break;
+            case op_t::disj: if (!ip->arg) { acc = false; } break;
+            }
+        }
+
+        return acc;
+    }
+
+    /**
+     * @brief Checks if the expression is true in 64 fact databases at once.
+     *        All lanes are evaluated, so jumps are ignored
+     * @param fb Fact columns, bit `i` of `fb[fact]` is set if the fact is
+     *           known in the `i`th database
+     * @param stack Buffer for results of operands
+     * @return Bit `i` is set if the expression is true in the `i`th database
+     */
+    std::uint64_t is(const std::uint64_t *fb,
+                     std::vector<std::uint64_t> &stack) const {
+        stack.clear();
+        for (auto ip = m_begin; ip != m_end; ++ip) {
+            const auto &in = *ip;
+            switch (in.op) {
+            case op_t::fact: stack.push_back(fb[in.arg]); break;
+            case op_t::no_fact: stack.push_back(~fb[in.arg]); break;
+            case op_t::neg: stack.back() = ~stack.back(); break;
+            case op_t::conj: {
+                auto acc = ~std::uint64_t(0);
+                for (auto n = in.arg; n; --n) {
+                    acc &= stack.back();
+                    stack.pop_back();
+                }
+                stack.push_back(acc);
+                break;
+            }
+            case op_t::disj: {
+                std::uint64_t acc = 0;
+                for (auto n = in.arg; n; --n) {
+                    acc |= stack.back();
+                    stack.pop_back();
+                }
+                stack.push_back(acc);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        return stack.back();
+    }
+
+    /**
+     * @brief Returns required facts like `exp_t::unknowns` does
+     * @param fb Fact database
+     * @return Required facts
+     */
+    unknowns_t<sym_t> unknowns(const fact_db_t &fb) const {
+        unknowns_scratch_t scratch;
+        collect(fb, scratch);
+        return std::move(scratch.m_uks);
+    }
+
+    /**
+     * @brief Appends facts which must become known to make the expression
+     *        true. Buffers are reused, so nothing is allocated once they
+     *        have grown
+     * @param fb Fact database
+     * @param scratch Reusable buffers
+     * @param out Output list
+     */
+    void unknowns(const fact_db_t &fb, unknowns_scratch_t &scratch,
+                  vals_t<sym_t> &out) const {
+        collect(fb, scratch);
+        for (const auto &uk : scratch.m_uks) {
+            if (uk.state) { out.push_back(uk.value); }
+        }
+    }
+private:
+    /**
+     * @brief Points the program to its own instructions or to instructions
+     *        the other program refers to
+     */
+    void attach(const program_t &other) {
+        if (m_code.empty()) { m_begin = other.m_begin; m_end = other.m_end; }
+        else { attach(); }
+    }
+
+    void attach() {
+        m_begin = m_code.data();
+        m_end = m_begin + m_code.size();
+    }
+
+    /**
+     * @brief Collects unknown facts of the expression into `scratch.m_uks`
+     */
+    void collect(const fact_db_t &fb, unknowns_scratch_t &scratch) const {
+        // Results of operands are adjacent segments of `uks`
+        auto &uks = scratch.m_uks;
+        auto &segs = scratch.m_segs;
+        uks.clear();
+        segs.clear();
+
+        for (auto ip = m_begin; ip != m_end; ++ip) {
+            const auto &in = *ip;
+            switch (in.op) {
+            case op_t::fact:
+            case op_t::no_fact:
+                segs.push_back(uks.size());
+                if (!fb.contains(in.arg)) {
+                    uks.emplace_back(in.op == op_t::fact, in.arg);
+                }
+                break;
+            case op_t::neg:
+                for (auto it = uks.begin() + segs.back(); it != uks.end();
+                     ++it) {
+                    it->state = !it->state;
+                }
+                break;
+            case op_t::conj:
+                if (!in.arg) { segs.push_back(uks.size()); }
+                else { largest(uks, segs, in.arg); }
+                break;
+            case op_t::disj:
+                if (!in.arg) { segs.push_back(uks.size()); }
+                else { plex(scratch, in.arg); }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief Replaces `n` top segments by the first largest one
+     */
+    static void largest(unknowns_t<sym_t> &uks, std::vector<std::size_t> &segs,
+                        std::uint32_t n) {
+        auto first = segs.size() - n;
+        std::size_t best = segs[first];
+        std::size_t best_size = seg_end(uks, segs, first) - best;
+        for (auto i = first + 1; i < segs.size(); ++i) {
+            auto size = seg_end(uks, segs, i) - segs[i];
+            if (size > best_size) { best = segs[i]; best_size = size; }
+        }
+
+        std::copy(uks.begin() + best, uks.begin() + best + best_size,
+                  uks.begin() + segs[first]);
+        uks.erase(uks.begin() + segs[first] + best_size, uks.end());
+        segs.resize(first + 1);
+    }
+
+    /**
+     * @brief Replaces `n` top segments by their union or by an empty segment
+     *        if any of them is empty
+     */
+    static void plex(unknowns_scratch_t &scratch, std::uint32_t n) {
+        auto &uks = scratch.m_uks;
+        auto &segs = scratch.m_segs;
+        auto first = segs.size() - n;
+        auto begin = segs[first];
+        auto end = seg_end(uks, segs, first);
+        bool reachable = begin == end;
+        for (auto i = first + 1; i < segs.size() && !reachable; ++i) {
+            reachable = segs[i] == seg_end(uks, segs, i);
+        }
+
+        if (reachable) { end = begin; }
+        else {
+            // Facts of the union are marked with their positions, segments
+            // don't contain duplicates
+            scratch.next_mark();
+            for (auto i = begin; i < end; ++i) {
+                scratch.mark(uks[i].value, i);
+            }
+            for (auto i = end; i < uks.size(); ++i) {
+                auto j = scratch.find(uks[i].value);
+                if (j == unknowns_scratch_t::npos) {
+                    scratch.mark(uks[i].value, end);
+                    uks[end++] = uks[i];
+                } else if (!uks[j].state && uks[i].state) {
+                    uks[j].state = true;
+                }
+            }
+        }
+        uks.erase(uks.begin() + end, uks.end());
+        segs.resize(first + 1);
+    }
+
+    static std::size_t seg_end(const unknowns_t<sym_t> &uks,
+                               const std::vector<std::size_t> &segs,
+                               std::size_t i) {
+        return i + 1 < segs.size() ? segs[i + 1] : uks.size();
+    }
+};
+
+/**
+ * This class lowers expressions into instructions
+ */
+template <typename val_t>
+class program_t::compiler_t : public exp_visitor_t<val_t> {
+    std::vector<instr_t> &m_code;
+public:
+    compiler_t(std::vector<instr_t> &code) : m_code{code} {}
+
+    virtual void visit(const exp_t<val_t> &) override {
+        m_code.push_back({op_t::conj, 0});
+    }
+
+    virtual void visit(const fact_t<val_t> &exp) override {
+        m_code.push_back({op_t::fact, exp.value()});
+    }
+
+    virtual void visit(const not_t<val_t> &exp) override {
+        exp.exp()->accept(*this);
+        // Negation of a fact is a single instruction
+        if (m_code.back().op == op_t::fact) {
+            m_code.back().op = op_t::no_fact;
+        } else if (m_code.back().op == op_t::no_fact) {
+            m_code.back().op = op_t::fact;
+        } else { m_code.push_back({op_t::neg, 0}); }
+    }
+
+    virtual void visit(const and_t<val_t> &exp) override {
+        operation(exp.exps(), op_t::jump_false, op_t::conj);
+    }
+
+    virtual void visit(const or_t<val_t> &exp) override {
+        operation(exp.exps(), op_t::jump_true, op_t::disj);
+    }
+private:
+    void operation(const exps_t<val_t> &exps, op_t jump, op_t close) {
+        std::vector<std::size_t> jumps;
+        for (auto it = exps.begin(); it != exps.end(); ++it) {
+            (*it)->accept(*this);
+            if (it + 1 != exps.end()) {
+                jumps.push_back(m_code.size());
+                m_code.push_back({jump, 0});
+            }
+        }
+        for (auto j : jumps) {
+            m_code[j].arg = static_cast<std::uint32_t>(m_code.size());
+        }
+        m_code.push_back({close, static_cast<std::uint32_t>(exps.size())});
+    }
+};
+
+template <typename val_t>
+program_t program_t::compile(const exp_t<val_t> *exp) {
+    program_t prog;
+    if (exp) {
+        prog.m_code.clear();
+        compiler_t<val_t> compiler(prog.m_code);
+        exp->accept(compiler);
+        prog.attach();
+    }
+    return prog;
+}
+
+template <typename val_t>
+exp_t<val_t> *program_t::decompile(std::size_t symbols,
+                                   arena_t *arena) const {
+    std::vector<std::unique_ptr<exp_t<val_t>>> stack;
+    for (auto ip = m_begin; ip != m_end; ++ip) {
+        const auto &in = *ip;
+        switch (in.op) {
+        case op_t::fact:
+        case op_t::no_fact:
+            if (in.arg >= symbols) { return nullptr; }
+            stack.emplace_back(_fact<val_t>(in.arg, arena));
+            if (in.op == op_t::no_fact) {
+                stack.back().reset(_not<val_t>(stack.back().release(), arena));
+            }
+            break;
+        case op_t::neg:
+            if (stack.empty()) { return nullptr; }
+            stack.back().reset(_not<val_t>(stack.back().release(), arena));
+            break;
+        case op_t::jump_false:
+        case op_t::jump_true:
+            if (m_begin + in.arg <= ip || m_begin + in.arg >= m_end) {
+                return nullptr;
+            }
+            break;
+        case op_t::conj:
+        case op_t::disj: {
+            if (in.arg > stack.size()) { return nullptr; }
+            if (!in.arg && in.op == op_t::conj) {
+                stack.emplace_back(new (arena) exp_t<val_t>());
+                break;
+            }
+            auto first = stack.end() - in.arg;
+            exps_t<val_t> exps(std::make_move_iterator(first),
+                               std::make_move_iterator(stack.end()),
+                               arena_resource(arena));
+            stack.erase(first, stack.end());
+            if (in.op == op_t::conj) {
+                stack.emplace_back(_and<val_t>(std::move(exps), arena));
+            } else { stack.emplace_back(_or<val_t>(std::move(exps), arena)); }
+            break;
+        }
+        default:
+            return nullptr;
+        }
+    }
+
+    return stack.size() == 1 ? stack.back().release() : nullptr;
+}
+
+}
+
+#endif // PROGRAM_HPP
@@ -0,0 +1,381 @@
+#ifndef PROVER_HPP
+#define PROVER_HPP
+
+#include "goal.hpp"
+#include "kb.hpp"
+#include "session.hpp"
+#include "tracer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+namespace xpertium {
+
+/**
+ * This class proves goals of the reverse output by a loop over the proof
+ * stack of the session instead of recursion, so deep knowledge databases
+ * don't overflow the thread stack. Goals are tried in the order of
+ * `expert_t`, which runs its reverse output by this class.
+ *
+ * A proof is suspended on every question like `async_expert_t` does and
+ * resumed by `answer()`. The stack grows by two frames per level of the
+ * proof, so the depth limit bounds its memory. Goals below the limit fail,
+ * and failures which depend on them aren't memoized except the failure of
+ * the root goal
+ */
+template <typename val_t>
+class prover_t {
+    using stage_t = proof_frame_t::stage_t;
+
+    const kb_t<val_t> *m_kb;
+    session_t<val_t> &m_session;
+    base_tracer_t<val_t> &m_tracer;
+    std::ostream &m_out;
+    const quest_t<val_t> *m_quest = nullptr;
+    const std::atomic<bool> *m_stop = nullptr;
+    sym_t m_answer = no_sym;
+    std::size_t m_first = 0;
+    std::size_t m_last = npos;
+    std::uint32_t m_max_depth = no_depth;
+    std::uint32_t m_depth = 0;
+    std::uint32_t m_cycle_depth = no_depth;
+    bool m_result = false;
+public:
+    /**
+     * Depth which means no limit
+     */
+    static constexpr std::uint32_t no_depth =
+            std::numeric_limits<std::uint32_t>::max();
+
+    /**
+     * Position which means all producers of the goal
+     */
+    static constexpr std::size_t npos =
+            std::numeric_limits<std::size_t>::max();
+
+    /**
+     * @brief Constructor
+     * @param kb Knowledge database
+     * @param session Session which keeps facts, goals and the proof stack
+     * @param tracer Stack tracer
+     * @param out Stream for messages of the consultation
+     */
+    prover_t(const kb_t<val_t> *kb, session_t<val_t> &session,
+             base_tracer_t<val_t> &tracer, std::ostream &out) :
+        m_kb{kb}, m_session{session}, m_tracer{tracer}, m_out{out} {}
+
+    /**
+     * @brief Constructor of a prover which continues the proof of another
+     *        one in a fork of its session, e.g. to try other answers to its
+     *        question. The stop flag isn't inherited
+     * @param other Prover
+     * @param session Fork of the session of `other`
+     * @param tracer Stack tracer
+     * @param out Stream for messages of the consultation
+     */
+    prover_t(const prover_t<val_t> &other, session_t<val_t> &session,
+             base_tracer_t<val_t> &tracer, std::ostream &out) :
+        m_kb{other.m_kb}, m_session{session}, m_tracer{tracer}, m_out{out},
+        m_quest{other.m_quest}, m_answer{other.m_answer},
+        m_first{other.m_first}, m_last{other.m_last},
+        m_max_depth{other.m_max_depth}, m_depth{other.m_depth},
+        m_cycle_depth{other.m_cycle_depth}, m_result{other.m_result} {}
+
+    /**
+     * @brief Returns the largest number of nested goals
+     */
+    std::uint32_t max_depth() const { return m_max_depth; }
+
+    /**
+     * @brief Sets the largest number of nested goals
+     * @param depth Depth (`no_depth` - no limit)
+     */
+    void max_depth(std::uint32_t depth) { m_max_depth = depth; }
+
+    /**
+     * @brief Sets the flag which cancels the proof, e.g. a speculative one.
+     *        A cancelled proof stops without a result
+     * @param stop Flag or `nullptr`
+     */
+    void stop_flag(const std::atomic<bool> *stop) { m_stop = stop; }
+
+    /**
+     * @brief Starts the proof of the goal, an unfinished proof is aborted
+     * @param goal Interned goal
+     * @param producer Position of the only producer of the goal to try in
+     *                 `kb_t::producers()` or `npos` to try all of them
+     * @return The first question or `nullptr` if the proof is done
+     */
+    const quest_t<val_t> *prove(sym_t goal, std::size_t producer = npos) {
+        abort();
+        m_first = producer != npos ? producer : 0;
+        m_last = producer != npos ? producer + 1 : npos;
+        m_session.frames().push_back({stage_t::goal, goal});
+
+        return run();
+    }
+
+    /**
+     * @brief Resumes the proof with the answer to the current question
+     * @param answer Answer
+     * @return The next question or `nullptr` if the proof is done
+     */
+    const quest_t<val_t> *answer(const val_t &answer) {
+        if (!m_quest) { return nullptr; }
+
+        m_answer = m_kb->symbols()->find(answer);
+        if (m_answer == no_sym) {
+            m_out << "Answer `" << answer << "` to question `"
+                  << m_quest->id() << "` is unknown" << std::endl;
+        }
+        m_quest = nullptr;
+
+        return run();
+    }
+
+    /**
+     * @brief Returns the question the proof waits for or `nullptr`
+     */
+    const quest_t<val_t> *question() const { return m_quest; }
+
+    /**
+     * @brief Returns `true` if the proof is finished
+     */
+    bool done() const { return m_session.frames().empty(); }
+
+    /**
+     * @brief Returns `true` if the finished proof achieved the goal
+     */
+    bool result() const { return done() && m_result; }
+private:
+    fact_db_t &facts() { return m_session.facts(); }
+
+    const val_t &value(sym_t fact) const {
+        return m_kb->symbols()->value(fact);
+    }
+
+    /**
+     * @brief Forgets an unfinished proof, its goals can be tried again
+     */
+    void abort() {
+        auto &frames = m_session.frames();
+        for (const auto &frame : frames) {
+            if (frame.stage >= stage_t::producers &&
+                    frame.stage <= stage_t::proved) {
+                m_session.goals().set(frame.goal, goal_state_t::unknown,
+                                      frame.depth);
+            }
+        }
+        frames.clear();
+        m_session.required().clear();
+        m_quest = nullptr;
+        m_depth = 0;
+        m_cycle_depth = no_depth;
+    }
+
+    /**
+     * @brief Runs frames until a question or the end of the proof
+     */
+    const quest_t<val_t> *run() {
+        auto &frames = m_session.frames();
+        while (!frames.empty()) {
+            if (m_stop && m_stop->load(std::memory_order_relaxed)) {
+                return nullptr;
+            }
+
+            auto &frame = frames.back();
+            switch (frame.stage) {
+            case stage_t::goal: enter_goal(frame); break;
+            case stage_t::producers:
+                if (!next_producer(frame)) { return m_quest; }
+                break;
+            case stage_t::asked:
+                frame.stage = stage_t::producers;
+                check_output(frame, m_answer);
+                break;
+            case stage_t::proved:
+                if (m_result) { leave_goal(true); }
+                else { frame.stage = stage_t::producers; }
+                break;
+            case stage_t::rule:
+                frame.begin = m_session.required().size();
+                frame.stage = stage_t::unknowns;
+                break;
+            case stage_t::unknowns: collect(frame); break;
+            case stage_t::required: next_required(frame); break;
+            case stage_t::reproved:
+                frame.stage = m_result ? stage_t::unknowns
+                                       : stage_t::required;
+                break;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * @brief Returns from the top frame
+     */
+    void leave(bool result) {
+        m_result = result;
+        m_session.frames().pop_back();
+    }
+
+    /**
+     * @brief Checks memoized goals and starts to try producers of the goal
+     */
+    void enter_goal(proof_frame_t &frame) {
+        auto &goals = m_session.goals();
+        if (facts().contains(frame.goal)) { return leave(true); }
+
+        switch (goals.state(frame.goal)) {
+        case goal_state_t::proven: return leave(true);
+        case goal_state_t::failed: return leave(false);
+        case goal_state_t::proving:
+            // The goal depends on itself
+            m_cycle_depth = std::min(m_cycle_depth,
+                                     goals.depth(frame.goal));
+            return leave(false);
+        default: break;
+        }
+
+        if (m_depth >= m_max_depth) {
+            // The failure depends on the limit, not on the goal
+            m_cycle_depth = 0;
+            return leave(false);
+        }
+
+        // The root goal can be limited to some of its producers
+        auto root = m_session.frames().size() == 1;
+        auto count = m_kb->producers(frame.goal).size();
+        frame.depth = m_depth++;
+        frame.outer = m_cycle_depth;
+        frame.stage = stage_t::producers;
+        frame.pos = root ? m_first : 0;
+        frame.end = root ? std::min(m_last, count) : count;
+        m_cycle_depth = no_depth;
+        goals.set(frame.goal, goal_state_t::proving, frame.depth);
+    }
+
+    /**
+     * @brief Memoizes the result of the top goal frame and returns from it
+     */
+    void leave_goal(bool result) {
+        auto &frame = m_session.frames().back();
+        auto &goals = m_session.goals();
+        auto depth = frame.depth;
+
+        --m_depth;
+        if (result) {
+            goals.set(frame.goal, goal_state_t::proven, depth);
+        } else if (m_cycle_depth >= depth) {
+            goals.set(frame.goal, goal_state_t::failed, depth);
+        } else {
+            // The failure depends on a goal which is still being proved
+            goals.set(frame.goal, goal_state_t::unknown, depth);
+        }
+        if (m_cycle_depth >= depth) { m_cycle_depth = no_depth; }
+        m_cycle_depth = std::min(m_cycle_depth, frame.outer);
+
+        leave(result);
+    }
+
+    /**
+     * @brief Takes the next rule which can produce the goal
+     * @return False if the proof is suspended on a question
+     */
+    bool next_producer(proof_frame_t &frame) {
+        const auto &rules = *m_kb->rules();
+        const auto &prods = m_kb->producers(frame.goal);
+        while (frame.pos < frame.end) {
+            // Nested proofs can use the rule
+            auto idx = prods[frame.pos];
+            if (m_session.is_used(idx)) {
+                ++frame.pos;
+                continue;
+            }
+
+            auto rule = rules[idx].get();
+            if (rule->question()) {
+                frame.stage = stage_t::asked;
+                m_quest = rule->question();
+                return false;
+            }
+            if (rule->out() == no_sym) {
+                m_out << "Rule `" << rule->id()
+                      << "` doesn't consist question or output" << std::endl;
+            }
+            if (check_output(frame, rule->out())) { return true; }
+        }
+
+        leave_goal(false);
+        return true;
+    }
+
+    /**
+     * @brief Checks if the current producer gives the goal and starts the
+     *        proof of its rule if it does
+     * @param frame Goal frame
+     * @param fact Output of the producer
+     * @return True if the rule frame is started
+     */
+    bool check_output(proof_frame_t &frame, sym_t fact) {
+        auto idx = m_kb->producers(frame.goal)[frame.pos++];
+        if (fact == no_sym) { return false; }
+
+        auto rule = (*m_kb->rules())[idx].get();
+        m_tracer.push_rule(rule, value(fact));
+        if (fact != frame.goal) { return false; }
+
+        m_session.use(idx);
+        frame.stage = stage_t::proved;
+        auto goal = frame.goal;
+        m_session.frames().push_back({stage_t::rule, goal, 0, 0, idx});
+
+        return true;
+    }
+
+    /**
+     * @brief Collects facts which the rule of the frame requires, the rule
+     *        is checked if there are no such facts
+     */
+    void collect(proof_frame_t &frame) {
+        auto &required = m_session.required();
+        auto rule = (*m_kb->rules())[frame.rule].get();
+        required.resize(frame.begin);
+        rule->unknowns(facts(), m_session.scratch(), required);
+        frame.end = required.size();
+        frame.pos = frame.begin;
+        frame.stage = stage_t::required;
+
+        if (frame.begin != frame.end) { return; }
+        if (m_session.is(frame.rule)) {
+            facts().insert(frame.goal);
+            m_tracer.push_fact(value(frame.goal));
+            return leave(true);
+        }
+        leave(false);
+    }
+
+    /**
+     * @brief Starts the proof of the next required fact
+     */
+    void next_required(proof_frame_t &frame) {
+        if (frame.pos == frame.end) {
+            m_session.required().resize(frame.begin);
+            return leave(false);
+        }
+
+        auto fact = m_session.required()[frame.pos++];
+        frame.stage = stage_t::reproved;
+        m_session.frames().push_back({stage_t::goal, fact});
+    }
+};
+
+}
+
+#endif // PROVER_HPP
@@ -1,6 +1,8 @@
 #ifndef QUESTION_HPP
 #define QUESTION_HPP
 
+#include "symbols.hpp"
+
 #include <initializer_list>
 #include <memory>
 #include <string>
@@ -15,14 +17,16 @@ template <typename val_t>
 class ans_t {
     val_t m_id;
     std::string m_title;
+    sym_t m_fact;
 public:
     /**
      * @brief Constructor
      * @param id Answer ID (it must define a new fact in the system)
      * @param title Human readable title
+     * @param fact Interned answer ID
      */
-    ans_t(val_t id, const std::string &title): m_id{id},
-        m_title{title} {}
+    ans_t(val_t id, const std::string &title, sym_t fact): m_id{id},
+        m_title{title}, m_fact{fact} {}
     /**
      * @brief Copy constructor
      */
@@ -57,6 +61,11 @@ public:
      * @brief Returns an ID of the answer
      */
     val_t id() const { return m_id; }
+
+    /**
+     * @brief Returns an interned ID of the answer
+     */
+    sym_t fact() const { return m_fact; }
 };
 
 template <typename val_t> using answers_t = std::vector<ans_t<val_t>>;
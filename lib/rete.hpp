@@ -0,0 +1,527 @@
+#ifndef RETE_HPP
+#define RETE_HPP
+
+#include "bitmap.hpp"
+#include "expression.hpp"
+#include "fact_db.hpp"
+#include "rule.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace xpertium {
+
+/**
+ * This class represents a discrimination network compiled from activating
+ * expressions of rules. Conjunctions and disjunctions are split into
+ * left-deep chains of binary nodes and equal nodes are shared, so rules with
+ * common subexpressions (e.g. conjunct prefixes) share the same nodes. The
+ * network is a hash-consed DAG of all conditions of the KB, so it's also
+ * evaluated top-down by `rete_cache_t`.
+ *
+ * The network is immutable, a session keeps its matches in `rete_state_t`
+ */
+template <typename val_t>
+class rete_t {
+public:
+    using node_t = std::uint32_t;
+
+    /**
+     * Invalid node
+     */
+    static constexpr node_t no_node = std::numeric_limits<node_t>::max();
+
+    /**
+     * Node types, a node is true if:
+     */
+    enum class kind_t : std::uint8_t {
+        fact, ///< the fact is known
+        neg,  ///< the child is false
+        conj, ///< all children are true (no children - always true)
+        disj  ///< any child is true (no children - always false)
+    };
+private:
+    std::vector<kind_t> m_kinds;
+    std::vector<std::uint8_t> m_arities;
+    std::vector<std::uint8_t> m_init;
+    std::vector<node_t> m_left;
+    std::vector<node_t> m_right;
+    std::vector<node_t> m_roots;
+    std::vector<std::uint32_t> m_parent_offs;
+    std::vector<node_t> m_parents;
+    std::vector<std::uint32_t> m_rule_offs;
+    std::vector<std::uint32_t> m_rules;
+    std::vector<node_t> m_fact_nodes;
+    bitmap_t m_init_agenda;
+
+    class builder_t;
+public:
+    /**
+     * @brief Constructor
+     * @param rules Production rules
+     * @param facts Number of interned facts
+     */
+    rete_t(const std::vector<std::unique_ptr<rule_t<val_t>>> &rules,
+           std::size_t facts);
+
+    /**
+     * @brief Deletes a copy constructor
+     */
+    rete_t(const rete_t<val_t> &) = delete;
+
+    /**
+     * @brief Move constructor
+     */
+    rete_t(rete_t &&) = default;
+
+    /**
+     * @brief Deletes a copy assignment
+     */
+    rete_t<val_t> &operator=(const rete_t<val_t> &) = delete;
+
+    /**
+     * @brief Move assignment
+     */
+    rete_t<val_t> &operator=(rete_t &&) = default;
+
+    /**
+     * @brief Returns a number of nodes
+     */
+    std::size_t size() const { return m_kinds.size(); }
+
+    /**
+     * @brief Returns a node which tests the fact or `no_node`
+     */
+    node_t fact_node(sym_t fact) const {
+        return fact < m_fact_nodes.size() ? m_fact_nodes[fact] : no_node;
+    }
+
+    /**
+     * @brief Returns `true` if the node with the counter of true children is
+     *        true
+     */
+    bool truth(node_t node, std::uint8_t count) const {
+        switch (m_kinds[node]) {
+        case kind_t::fact: return count != 0;
+        case kind_t::neg: return count == 0;
+        case kind_t::conj: return count == m_arities[node];
+        default: return count != 0;
+        }
+    }
+
+    /**
+     * @brief Returns the type of the node
+     */
+    kind_t kind(node_t node) const { return m_kinds[node]; }
+
+    /**
+     * @brief Returns a number of children of the node
+     */
+    std::uint8_t arity(node_t node) const { return m_arities[node]; }
+
+    /**
+     * @brief Returns the first child of the node or the fact of a fact node
+     */
+    node_t left(node_t node) const { return m_left[node]; }
+
+    /**
+     * @brief Returns the second child of the node or `no_node`
+     */
+    node_t right(node_t node) const { return m_right[node]; }
+
+    /**
+     * @brief Returns the node of the activating expression of the rule
+     * @param rule Rule index
+     */
+    node_t root(std::size_t rule) const { return m_roots[rule]; }
+
+    /**
+     * @brief Returns counters of true children for an empty fact database
+     */
+    const std::vector<std::uint8_t> &init() const { return m_init; }
+
+    /**
+     * @brief Returns rules activated for an empty fact database
+     */
+    const bitmap_t &init_agenda() const { return m_init_agenda; }
+
+    /**
+     * @brief Returns the range of parents of the node
+     */
+    std::pair<const node_t *, const node_t *> parents(node_t node) const {
+        auto data = m_parents.data();
+        return {data + m_parent_offs[node], data + m_parent_offs[node + 1]};
+    }
+
+    /**
+     * @brief Returns the range of rules which are activated by the node
+     */
+    std::pair<const std::uint32_t *, const std::uint32_t *>
+    rules(node_t node) const {
+        auto data = m_rules.data();
+        return {data + m_rule_offs[node], data + m_rule_offs[node + 1]};
+    }
+};
+
+/**
+ * This class compiles expressions into nodes of the network
+ */
+template <typename val_t>
+class rete_t<val_t>::builder_t : public exp_visitor_t<val_t> {
+    struct key_t {
+        kind_t kind;
+        std::uint8_t arity;
+        node_t left, right;
+
+        bool operator==(const key_t &other) const {
+            return kind == other.kind && arity == other.arity &&
+                    left == other.left && right == other.right;
+        }
+    };
+
+    struct hash_t {
+        std::size_t operator()(const key_t &key) const {
+            auto h = static_cast<std::size_t>(key.kind) * 31 + key.arity;
+            h = h * 0x9e3779b97f4a7c15ull + key.left;
+            return h * 0x9e3779b97f4a7c15ull + key.right;
+        }
+    };
+
+    rete_t<val_t> &m_net;
+    std::unordered_map<key_t, node_t, hash_t> m_nodes;
+    node_t m_last = no_node;
+public:
+    std::vector<std::vector<node_t>> parents;
+
+    builder_t(rete_t<val_t> &net) : m_net{net} {}
+
+    /**
+     * @brief Compiles the expression and returns its root node
+     */
+    node_t build(const exp_t<val_t> &exp) {
+        exp.accept(*this);
+        return m_last;
+    }
+
+    virtual void visit(const exp_t<val_t> &) override {
+        m_last = node({kind_t::conj, 0, no_node, no_node});
+    }
+
+    virtual void visit(const fact_t<val_t> &exp) override {
+        m_last = node({kind_t::fact, 1, exp.value(), no_node});
+    }
+
+    virtual void visit(const not_t<val_t> &exp) override {
+        m_last = node({kind_t::neg, 1, build(*exp.exp()), no_node});
+    }
+
+    virtual void visit(const and_t<val_t> &exp) override {
+        m_last = chain(kind_t::conj, exp.exps());
+    }
+
+    virtual void visit(const or_t<val_t> &exp) override {
+        m_last = chain(kind_t::disj, exp.exps());
+    }
+private:
+    node_t chain(kind_t kind, const exps_t<val_t> &exps) {
+        if (exps.empty()) { return node({kind, 0, no_node, no_node}); }
+
+        auto left = build(*exps.front());
+        for (auto it = exps.begin() + 1; it != exps.end(); ++it) {
+            auto right = build(**it);
+            // Both operations are commutative
+            if (right < left) { std::swap(left, right); }
+            left = node({kind, 2, left, right});
+        }
+
+        return left;
+    }
+
+    node_t node(const key_t &key) {
+        auto res = m_nodes.emplace(key, static_cast<node_t>(m_net.size()));
+        if (!res.second) { return res.first->second; }
+
+        auto id = res.first->second;
+        std::uint8_t count = 0;
+        if (key.kind == kind_t::fact) {
+            if (key.left >= m_net.m_fact_nodes.size()) {
+                m_net.m_fact_nodes.resize(key.left + 1, no_node);
+            }
+            m_net.m_fact_nodes[key.left] = id;
+        } else {
+            // Children are always created before their parents
+            for (auto child : {key.left, key.right}) {
+                if (child == no_node) { continue; }
+                parents[child].push_back(id);
+                count += m_net.truth(child, m_net.m_init[child]);
+            }
+        }
+        m_net.m_kinds.push_back(key.kind);
+        m_net.m_arities.push_back(key.arity);
+        m_net.m_init.push_back(count);
+        m_net.m_left.push_back(key.left);
+        m_net.m_right.push_back(key.right);
+        parents.emplace_back();
+
+        return id;
+    }
+};
+
+template <typename val_t>
+rete_t<val_t>::rete_t(
+        const std::vector<std::unique_ptr<rule_t<val_t>>> &rules,
+        std::size_t facts) :
+    m_fact_nodes(facts, no_node), m_init_agenda{rules.size()} {
+    builder_t builder(*this);
+    auto &roots = m_roots;
+    for (const auto &rule : rules) {
+        roots.push_back(rule->exp() ? builder.build(*rule->exp())
+                                    : builder.build(exp_t<val_t>()));
+    }
+
+    m_parent_offs.push_back(0);
+    for (const auto &ps : builder.parents) {
+        m_parents.insert(m_parents.end(), ps.begin(), ps.end());
+        m_parent_offs.push_back(static_cast<std::uint32_t>(m_parents.size()));
+    }
+
+    std::vector<std::uint32_t> counts(size() + 1);
+    for (auto root : roots) { ++counts[root + 1]; }
+    for (std::size_t i = 1; i < counts.size(); ++i) {
+        counts[i] += counts[i - 1];
+    }
+    m_rule_offs = counts;
+    m_rules.resize(rules.size());
+    for (std::uint32_t idx = 0; idx < roots.size(); ++idx) {
+        m_rules[counts[roots[idx]]++] = idx;
+        if (truth(roots[idx], m_init[roots[idx]])) { m_init_agenda.set(idx); }
+    }
+}
+
+/**
+ * This class keeps matches of the network for a single session. They persist
+ * between fact insertions, so a new fact costs only nodes it changes
+ */
+template <typename val_t>
+class rete_state_t {
+    using node_t = typename rete_t<val_t>::node_t;
+
+    const rete_t<val_t> *m_net;
+    std::vector<std::uint8_t> m_counts;
+    bitmap_t m_agenda;
+    bitmap_t m_retired;
+    std::vector<std::pair<node_t, bool>> m_stack;
+    std::size_t m_synced = 0;
+    bool m_valid = false;
+public:
+    /**
+     * @brief Constructor
+     * @param net Network
+     */
+    explicit rete_state_t(const rete_t<val_t> *net) : m_net{net} {}
+
+    rete_state_t(const rete_state_t<val_t> &) = default;
+    rete_state_t(rete_state_t &&) = default;
+
+    rete_state_t<val_t> &operator=(const rete_state_t<val_t> &) = default;
+    rete_state_t<val_t> &operator=(rete_state_t &&) = default;
+
+    /**
+     * @brief Returns `false` if the state must be reset before using
+     */
+    bool valid() const { return m_valid; }
+
+    /**
+     * @brief Marks the state as outdated
+     */
+    void invalidate() { m_valid = false; }
+
+    /**
+     * @brief Resets matches to an empty fact database
+     */
+    void reset() {
+        m_counts = m_net->init();
+        m_agenda = m_net->init_agenda();
+        m_retired = bitmap_t(m_agenda.size());
+        m_synced = 0;
+        m_valid = true;
+    }
+
+    /**
+     * @brief Propagates facts added since the last synchronization
+     * @param fb Fact database
+     */
+    void sync(const fact_db_t &fb) {
+        for (; m_synced < fb.size(); ++m_synced) { add(fb[m_synced]); }
+    }
+
+    /**
+     * @brief Excludes the rule from the agenda forever
+     * @param rule Rule index
+     */
+    void retire(std::size_t rule) {
+        m_retired.set(rule);
+        m_agenda.reset(rule);
+    }
+
+    /**
+     * @brief Returns the next activated rule
+     * @param from Start rule index
+     * @return Rule index or `bitmap_t::npos`
+     */
+    std::size_t next(std::size_t from) const { return m_agenda.next(from); }
+private:
+    void add(sym_t fact) {
+        auto node = m_net->fact_node(fact);
+        if (node == rete_t<val_t>::no_node || m_counts[node]) { return; }
+
+        m_counts[node] = 1;
+        m_stack.emplace_back(node, true);
+        while (!m_stack.empty()) {
+            auto [n, state] = m_stack.back();
+            m_stack.pop_back();
+
+            auto rules = m_net->rules(n);
+            for (auto r = rules.first; r != rules.second; ++r) {
+                if (state && !m_retired.test(*r)) { m_agenda.set(*r); }
+                else { m_agenda.reset(*r); }
+            }
+
+            auto parents = m_net->parents(n);
+            for (auto p = parents.first; p != parents.second; ++p) {
+                bool old = m_net->truth(*p, m_counts[*p]);
+                if (state) { ++m_counts[*p]; } else { --m_counts[*p]; }
+                bool cur = m_net->truth(*p, m_counts[*p]);
+                if (old != cur) { m_stack.emplace_back(*p, cur); }
+            }
+        }
+    }
+};
+
+/**
+ * This class caches values of nodes of the network for a single session.
+ * A value is valid while the fact database has the same version, so a
+ * subexpression shared by many rules is evaluated at most once per version.
+ * The fact database only grows between resets, so its size is the version
+ * and `invalidate()` starts a new one after a reset
+ */
+template <typename val_t>
+class rete_cache_t {
+    using node_t = typename rete_t<val_t>::node_t;
+    using kind_t = typename rete_t<val_t>::kind_t;
+
+    const rete_t<val_t> *m_net;
+    std::vector<std::uint32_t> m_stamps;
+    bitmap_t m_values;
+    std::vector<node_t> m_stack;
+    std::uint32_t m_version = 0;
+    std::size_t m_size = 0;
+public:
+    /**
+     * @brief Constructor
+     * @param net Network
+     */
+    explicit rete_cache_t(const rete_t<val_t> *net) : m_net{net} {}
+
+    rete_cache_t(const rete_cache_t<val_t> &) = default;
+    rete_cache_t(rete_cache_t &&) = default;
+
+    rete_cache_t<val_t> &operator=(const rete_cache_t<val_t> &) = default;
+    rete_cache_t<val_t> &operator=(rete_cache_t &&) = default;
+
+    /**
+     * @brief Forgets all values, e.g. when the fact database was cleared
+     */
+    void invalidate() { next_version(); }
+
+    /**
+     * @brief Checks if the activating expression of the rule is true
+     * @param rule Rule index
+     * @param fb Fact database
+     * @return Check result
+     */
+    bool is(std::size_t rule, const fact_db_t &fb) {
+        if (m_stamps.empty()) {
+            // Cells are allocated by the first check, so idle sessions
+            // don't pay for them
+            m_stamps.assign(m_net->size(), 0);
+            m_values = bitmap_t(m_net->size());
+            next_version();
+        }
+        if (fb.size() != m_size) {
+            m_size = fb.size();
+            next_version();
+        }
+
+        auto root = m_net->root(rule);
+        m_stack.assign(1, root);
+        while (!m_stack.empty()) {
+            auto node = m_stack.back();
+            if (m_stamps[node] == m_version) {
+                m_stack.pop_back();
+                continue;
+            }
+            if (eval(node, fb)) { m_stack.pop_back(); }
+        }
+
+        return m_values.test(root);
+    }
+private:
+    void next_version() {
+        if (++m_version == 0) {
+            std::fill(m_stamps.begin(), m_stamps.end(), 0);
+            m_version = 1;
+        }
+    }
+
+    bool known(node_t node) const { return m_stamps[node] == m_version; }
+
+    void set(node_t node, bool value) {
+        m_stamps[node] = m_version;
+        if (value) { m_values.set(node); } else { m_values.reset(node); }
+    }
+
+    /**
+     * @brief Evaluates the node if its children are known, otherwise pushes
+     *        the next required child
+     * @return True if the node was evaluated
+     */
+    bool eval(node_t node, const fact_db_t &fb) {
+        auto left = m_net->left(node);
+        switch (m_net->kind(node)) {
+        case kind_t::fact:
+            set(node, fb.contains(left));
+            return true;
+        case kind_t::neg:
+            if (!known(left)) { m_stack.push_back(left); return false; }
+            set(node, !m_values.test(left));
+            return true;
+        default:
+            break;
+        }
+
+        bool conj = m_net->kind(node) == kind_t::conj;
+        if (!m_net->arity(node)) {
+            set(node, conj);
+            return true;
+        }
+        if (!known(left)) { m_stack.push_back(left); return false; }
+        // The right operand is skipped as soon as the result is known
+        auto right = m_net->right(node);
+        if (m_values.test(left) != conj || right == rete_t<val_t>::no_node) {
+            set(node, m_values.test(left));
+            return true;
+        }
+        if (!known(right)) { m_stack.push_back(right); return false; }
+        set(node, m_values.test(right));
+        return true;
+    }
+};
+
+}
+
+#endif // RETE_HPP
@@ -1,26 +1,36 @@
 #ifndef RULE_T_HPP
 #define RULE_T_HPP
 
+#include "arena.hpp"
 #include "expression.hpp"
+#include "program.hpp"
 #include "question.hpp"
 #include "unknown.hpp"
 
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace xpertium {
 
+template <typename val_t> class kb_t;
+
 /**
- * This class represents a production-rule in the system
+ * This class represents a production-rule in the system. Rules can be placed
+ * in an arena of the knowledge database
  */
 template<class val_t>
-class rule_t {
+class rule_t: public arena_object_t {
+    friend class kb_t<val_t>;
+
     std::string m_id;
     std::unique_ptr<exp_t<val_t>> m_exp;
-    quest_t<val_t> *m_quest;
-    std::unique_ptr<val_t> m_out;
+    program_t m_prog;
+    const quest_t<val_t> *m_quest;
+    sym_t m_out;
     bool m_target;
+    std::size_t m_index = 0;
 public:
     /**
      * @brief Constructor
@@ -28,11 +38,26 @@ public:
      * @param exp Pointer to an activating logical expression
      * @param quest Question pointer
      * @param target Is it a target rule?
-     * @param out Rule output
+     * @param out Interned rule output (`no_sym` if the rule has no output)
+     */
+    rule_t(const std::string &id, exp_t<val_t> *exp,
+           const quest_t<val_t> *quest, bool target, sym_t out) :
+        m_id{id}, m_exp{exp}, m_prog{program_t::compile(exp)},
+        m_quest{quest}, m_out{out}, m_target{target} {}
+
+    /**
+     * @brief Constructor of a rule with an already compiled expression
+     * @param id Rule ID
+     * @param exp Pointer to an activating logical expression
+     * @param prog Program of the activating expression
+     * @param quest Question pointer
+     * @param target Is it a target rule?
+     * @param out Interned rule output (`no_sym` if the rule has no output)
      */
-    rule_t(const std::string &id, exp_t<val_t> *exp, quest_t<val_t> *quest,
-           bool target, val_t *out) :
-        m_id{id}, m_exp{exp}, m_quest{quest}, m_target{target}, m_out{out} {}
+    rule_t(const std::string &id, exp_t<val_t> *exp, program_t &&prog,
+           const quest_t<val_t> *quest, bool target, sym_t out) :
+        m_id{id}, m_exp{exp}, m_prog{std::move(prog)}, m_quest{quest},
+        m_out{out}, m_target{target} {}
 
     /**
      * @brief Constructor
@@ -41,8 +66,9 @@ public:
      * @param q_id Question pointer
      * @param target Is it a target rule?
      */
-    rule_t(const std::string &id, exp_t<val_t> *exp, quest_t<val_t> *quest,
-           bool target) : rule_t{id, exp, quest, false, nullptr} {}
+    rule_t(const std::string &id, exp_t<val_t> *exp,
+           const quest_t<val_t> *quest, bool target) :
+        rule_t{id, exp, quest, target, no_sym} {}
 
     /**
      * @brief Deletes a copy constructor
@@ -74,13 +100,18 @@ public:
      * @param fb Fact database
      * @return Check result
      */
-    bool is(const vals_t<val_t> &fb) const { return m_exp->is(fb); }
+    bool is(const fact_db_t &fb) const { return m_prog.is(fb); }
 
     /**
      * @brief Returns a rule ID
      */
     const std::string &id() const { return m_id; }
 
+    /**
+     * @brief Returns a position of the rule in the knowledge database
+     */
+    std::size_t index() const { return m_index; }
+
     /**
      * @brief Returns the linked question
      */
@@ -92,39 +123,67 @@ public:
     bool target() const { return m_target; }
 
     /**
-     * @brief Returns a rule output (can be `nullptr`)
+     * @brief Returns an interned rule output (can be `no_sym`)
      */
-    const val_t *out() const { return m_out.get(); }
+    sym_t out() const { return m_out; }
 
     /**
      * @brief Returns required facts
      * @param fb Fact database
      * @return Required facts
      */
-    vals_t<val_t> unknowns(const vals_t<val_t> &fb) const {
-        vals_t<val_t> facts;
+    vals_t<sym_t> unknowns(const fact_db_t &fb) const {
+        vals_t<sym_t> facts;
 
-        if (m_exp) {
-            auto uks = m_exp->unknowns(fb);
-            for (auto it = uks.begin(); it != uks.end(); ++it) {
-                if (it->state) { facts.push_back(it->value); }
-            }
+        auto uks = m_prog.unknowns(fb);
+        for (auto it = uks.begin(); it != uks.end(); ++it) {
+            if (it->state) { facts.push_back(it->value); }
         }
 
         return facts;
     }
 
+    /**
+     * @brief Appends required facts without allocations once buffers have
+     *        grown
+     * @param fb Fact database
+     * @param scratch Reusable buffers
+     * @param out Output list
+     */
+    void unknowns(const fact_db_t &fb, unknowns_scratch_t &scratch,
+                  vals_t<sym_t> &out) const {
+        m_prog.unknowns(fb, scratch, out);
+    }
+
+    /**
+     * @brief Returns the activating logical expression
+     */
+    const exp_t<val_t> *exp() const { return m_exp.get(); }
+
+    /**
+     * @brief Returns the compiled activating logical expression
+     */
+    const program_t &program() const { return m_prog; }
+
+    /**
+     * @brief Collects all facts mentioned by the activating expression
+     * @param facts Output list (it can contain duplicates)
+     */
+    void facts(vals_t<sym_t> &facts) const {
+        if (m_exp) { m_exp->facts(facts); }
+    }
+
     /**
      * @brief Checks if `value` is a possible output for the rule
-     * @param value Possible output fact
+     * @param value Interned possible output fact
      * @return Check result
      */
-    bool is_possible_out(val_t value) const {
-        if (m_out && (*m_out) == value) { return true; }
+    bool is_possible_out(sym_t value) const {
+        if (m_out != no_sym && m_out == value) { return true; }
         if (m_quest) {
-            auto ans = m_quest->answers();
+            const auto &ans = m_quest->answers();
             for (auto it = ans.begin(); it != ans.end(); ++it) {
-                if (it->id() == value) { return true; }
+                if (it->fact() == value) { return true; }
             }
         }
         return false;
@@ -0,0 +1,151 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include "fact_db.hpp"
+#include "goal.hpp"
+#include "kb.hpp"
+#include "rete.hpp"
+
+namespace xpertium {
+
+/**
+ * This class keeps the state of a single consultation: known facts, used
+ * rules, memoized goals and cached values of conditions. The knowledge
+ * database is only read, so any number of sessions can share a single loaded
+ * `kb_t` without locking.
+ *
+ * All containers grow on demand and `reset()` clears only what was touched,
+ * so creating and resetting a session costs O(active state), not O(rules).
+ * Facts, used rules and goals are flat until the session is forked, then
+ * forks share their pages and diverge without copying them
+ */
+template <typename val_t>
+class session_t {
+    const kb_t<val_t> *m_kb;
+    fact_db_t m_facts;
+    id_set_t m_used;
+    goal_table_t m_goals;
+    rete_state_t<val_t> m_rete;
+    rete_cache_t<val_t> m_cache;
+    vals_t<sym_t> m_required;
+    unknowns_scratch_t m_scratch;
+    std::vector<proof_frame_t> m_frames;
+public:
+    /**
+     * @brief Constructor
+     * @param kb Knowledge database
+     */
+    explicit session_t(const kb_t<val_t> *kb) :
+        m_kb{kb}, m_rete{kb->rete()}, m_cache{kb->rete()} {}
+
+    session_t(const session_t<val_t> &) = default;
+    session_t(session_t &&) = default;
+
+    session_t<val_t> &operator=(const session_t<val_t> &) = default;
+    session_t<val_t> &operator=(session_t &&) = default;
+
+    /**
+     * @brief Returns a session which starts with the state of this one and
+     *        changes independently, e.g. to answer the current question of
+     *        a suspended proof differently. Facts, used rules and goals are
+     *        shared until one of the sessions changes them: the first fork
+     *        moves them to pages in O(their size), later forks share them
+     *        in O(1). The unfinished proof is copied in O(its depth). Caches
+     *        of the fork are empty, so its first direct output rebuilds
+     *        matches of the discrimination network in O(network + facts)
+     */
+    session_t<val_t> fork() {
+        session_t<val_t> res(m_kb);
+        res.m_facts = m_facts.fork();
+        res.m_used = m_used.fork();
+        res.m_goals = m_goals.fork();
+        res.m_required = m_required;
+        res.m_frames = m_frames;
+        return res;
+    }
+
+    /**
+     * @brief Returns the knowledge database
+     */
+    const kb_t<val_t> *kb() const { return m_kb; }
+
+    /**
+     * @brief Returns known facts
+     */
+    const fact_db_t &facts() const { return m_facts; }
+
+    /**
+     * @brief Returns known facts
+     */
+    fact_db_t &facts() { return m_facts; }
+
+    /**
+     * @brief Returns indexes of used rules in the order of use
+     */
+    const id_set_t &used() const { return m_used; }
+
+    /**
+     * @brief Returns `true` if the rule was fired or consumed by a proof
+     * @param rule Rule index
+     */
+    bool is_used(std::size_t rule) const {
+        return m_used.contains(static_cast<sym_t>(rule));
+    }
+
+    /**
+     * @brief Marks the rule as used, it won't be activated again
+     * @param rule Rule index
+     */
+    void use(std::size_t rule) { m_used.insert(static_cast<sym_t>(rule)); }
+
+    /**
+     * @brief Returns memoized goals of the reverse output
+     */
+    goal_table_t &goals() { return m_goals; }
+
+    /**
+     * @brief Returns matches of the discrimination network
+     */
+    rete_state_t<val_t> &rete() { return m_rete; }
+
+    /**
+     * @brief Checks if the activating expression of the rule is true, values
+     *        of shared subexpressions are reused until facts are changed
+     * @param rule Rule index
+     */
+    bool is(std::size_t rule) { return m_cache.is(rule, m_facts); }
+
+    /**
+     * @brief Returns a stack of required facts of the reverse output, every
+     *        proof appends its facts and removes them when it's done
+     */
+    vals_t<sym_t> &required() { return m_required; }
+
+    /**
+     * @brief Returns buffers of `rule_t::unknowns`
+     */
+    unknowns_scratch_t &scratch() { return m_scratch; }
+
+    /**
+     * @brief Returns the proof stack of the reverse output, its memory is
+     *        kept between consultations
+     */
+    std::vector<proof_frame_t> &frames() { return m_frames; }
+
+    /**
+     * @brief Forgets all facts, used rules and goals
+     */
+    void reset() {
+        m_facts.clear();
+        m_used.clear();
+        m_goals.clear();
+        m_rete.invalidate();
+        m_cache.invalidate();
+        m_required.clear();
+        m_frames.clear();
+    }
+};
+
+}
+
+#endif // SESSION_HPP
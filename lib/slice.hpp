@@ -0,0 +1,129 @@
+#ifndef SLICE_HPP
+#define SLICE_HPP
+
+#include "bitmap.hpp"
+#include "strata.hpp"
+#include "symbols.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace xpertium {
+
+/**
+ * This class represents rules which can contribute to a target: rules that
+ * produce the target and, transitively, rules that produce facts mentioned
+ * by expressions of the slice. Negative conditions are dependencies too, so
+ * rules outside the slice can't change values of expressions inside it and
+ * the engine can skip them
+ */
+class slice_t {
+    std::vector<std::size_t> m_rules;
+    bitmap_t m_members;
+    strata_t m_strata;
+    bool m_asks = false;
+public:
+    /**
+     * @brief Constructor
+     * @param kb Knowledge database
+     * @param target Interned target fact
+     */
+    template <typename kb_t>
+    slice_t(const kb_t &kb, sym_t target) :
+        m_members(kb.rules()->size()) {
+        const auto &rules = *kb.rules();
+
+        bitmap_t seen(kb.symbols()->size());
+        vals_t<sym_t> facts;
+        auto add = [this, &kb] (sym_t fact) {
+            for (auto r : kb.producers(fact)) {
+                if (!m_members.test(r)) {
+                    m_members.set(r);
+                    m_rules.push_back(r);
+                }
+            }
+        };
+
+        if (target < seen.size()) {
+            seen.set(target);
+            add(target);
+        }
+        for (std::size_t i = 0; i < m_rules.size(); ++i) {
+            m_asks = m_asks || rules[m_rules[i]]->question();
+            facts.clear();
+            rules[m_rules[i]]->facts(facts);
+            for (auto fact : facts) {
+                if (seen.test(fact)) { continue; }
+                seen.set(fact);
+                add(fact);
+            }
+        }
+
+        std::sort(m_rules.begin(), m_rules.end());
+        m_strata = kb.strata().filter(m_members);
+    }
+
+    slice_t(const slice_t &) = default;
+    slice_t(slice_t &&) = default;
+
+    slice_t &operator=(const slice_t &) = default;
+    slice_t &operator=(slice_t &&) = default;
+
+    /**
+     * @brief Returns indexes of rules of the slice in ascending order
+     */
+    const std::vector<std::size_t> &rules() const { return m_rules; }
+
+    /**
+     * @brief Returns rules of the slice in the order of evaluation
+     */
+    const strata_t &strata() const { return m_strata; }
+
+    /**
+     * @brief Returns a bitmap of rules of the slice
+     */
+    const bitmap_t &members() const { return m_members; }
+
+    /**
+     * @brief Returns `true` if any rule of the slice has a question, so
+     *        proofs of the target can ask the user
+     */
+    bool asks() const { return m_asks; }
+
+    /**
+     * @brief Returns `true` if the rule belongs to the slice
+     * @param rule Rule index
+     */
+    bool contains(std::size_t rule) const { return m_members.test(rule); }
+};
+
+/**
+ * This class builds slices of the knowledge database on demand and keeps
+ * them. Sessions share a single cache, so it's locked
+ */
+class slice_cache_t {
+    std::mutex m_mutex;
+    std::unordered_map<sym_t, std::unique_ptr<const slice_t>> m_slices;
+public:
+    /**
+     * @brief Returns the slice of the target, it's valid until the cache is
+     *        destroyed
+     * @param kb Knowledge database
+     * @param target Interned target fact
+     */
+    template <typename kb_t>
+    const slice_t &get(const kb_t &kb, sym_t target) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto &slice = m_slices[target];
+        if (!slice) { slice = std::make_unique<const slice_t>(kb, target); }
+        return *slice;
+    }
+};
+
+}
+
+#endif // SLICE_HPP
@@ -0,0 +1,201 @@
+#ifndef STRATA_HPP
+#define STRATA_HPP
+
+#include "bitmap.hpp"
+#include "symbols.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace xpertium {
+
+/**
+ * This class orders rules by strongly connected components of their
+ * dependency graph: a rule depends on producers of every fact its expression
+ * mentions (negative conditions included). Components follow their
+ * dependencies, so a component without cycles needs a single check of its
+ * rule and only cyclic components have to be iterated to a fixpoint. Rules
+ * of a component are in ascending order
+ */
+class strata_t {
+    std::vector<std::size_t> m_rules;
+    std::vector<std::size_t> m_offs{0};
+    std::vector<bool> m_cyclic;
+public:
+    /**
+     * @brief Constructor of empty strata
+     */
+    strata_t() = default;
+
+    /**
+     * @brief Constructor
+     * @param kb Knowledge database with built indexes of facts
+     */
+    template <typename kb_t>
+    explicit strata_t(const kb_t &kb) {
+        const auto &rules = *kb.rules();
+        auto count = rules.size();
+
+        // Dependencies of the rule `r` are `deps[offs[r]..offs[r + 1])`
+        std::vector<std::size_t> deps;
+        std::vector<std::size_t> offs;
+        offs.reserve(count + 1);
+        vals_t<sym_t> facts;
+        for (std::size_t r = 0; r < count; ++r) {
+            offs.push_back(deps.size());
+            facts.clear();
+            rules[r]->facts(facts);
+            std::sort(facts.begin(), facts.end());
+            auto last = std::unique(facts.begin(), facts.end());
+            for (auto it = facts.begin(); it != last; ++it) {
+                const auto &prods = kb.producers(*it);
+                deps.insert(deps.end(), prods.begin(), prods.end());
+            }
+        }
+        offs.push_back(deps.size());
+
+        build(deps, offs);
+    }
+
+    strata_t(const strata_t &) = default;
+    strata_t(strata_t &&) = default;
+
+    strata_t &operator=(const strata_t &) = default;
+    strata_t &operator=(strata_t &&) = default;
+
+    /**
+     * @brief Returns a number of components
+     */
+    std::size_t size() const { return m_cyclic.size(); }
+
+    /**
+     * @brief Returns indexes of all rules in the order of components
+     */
+    const std::vector<std::size_t> &rules() const { return m_rules; }
+
+    /**
+     * @brief Returns an iterator of the first rule of the component
+     */
+    auto begin(std::size_t comp) const {
+        return m_rules.begin() + m_offs[comp];
+    }
+
+    /**
+     * @brief Returns an iterator after the last rule of the component
+     */
+    auto end(std::size_t comp) const {
+        return m_rules.begin() + m_offs[comp + 1];
+    }
+
+    /**
+     * @brief Returns `true` if rules of the component depend on each other
+     */
+    bool cyclic(std::size_t comp) const { return m_cyclic[comp]; }
+
+    /**
+     * @brief Returns components which contain the rules. The set of rules
+     *        must be closed under dependencies like a slice is, so it
+     *        consists of whole components
+     * @param members Rules
+     */
+    strata_t filter(const bitmap_t &members) const {
+        strata_t res;
+        for (std::size_t comp = 0; comp < size(); ++comp) {
+            for (auto it = begin(comp); it != end(comp); ++it) {
+                if (members.test(*it)) { res.m_rules.push_back(*it); }
+            }
+            if (res.m_rules.size() != res.m_offs.back()) {
+                res.m_offs.push_back(res.m_rules.size());
+                res.m_cyclic.push_back(m_cyclic[comp]);
+            }
+        }
+
+        return res;
+    }
+private:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    /**
+     * @brief Finds components by Tarjan's algorithm. It completes a
+     *        component after all components it depends on, so they are
+     *        emitted in the order of evaluation
+     * @param deps Dependencies of rules
+     * @param offs Offsets of dependencies of rules
+     */
+    void build(const std::vector<std::size_t> &deps,
+               const std::vector<std::size_t> &offs) {
+        auto count = offs.size() - 1;
+        std::vector<std::size_t> index(count, npos);
+        std::vector<std::size_t> low(count);
+        bitmap_t on_stack(count);
+        std::vector<std::size_t> stack;
+        std::size_t next_index = 0;
+
+        // Frames keep a rule and its next dependency to visit
+        std::vector<std::pair<std::size_t, std::size_t>> frames;
+        auto visit = [&] (std::size_t rule) {
+            index[rule] = low[rule] = next_index++;
+            stack.push_back(rule);
+            on_stack.set(rule);
+            frames.emplace_back(rule, offs[rule]);
+        };
+
+        m_rules.reserve(count);
+        for (std::size_t root = 0; root < count; ++root) {
+            if (index[root] != npos) { continue; }
+            visit(root);
+            while (!frames.empty()) {
+                auto rule = frames.back().first;
+                auto dep = frames.back().second;
+                if (dep != offs[rule + 1]) {
+                    ++frames.back().second;
+                    auto next = deps[dep];
+                    if (index[next] == npos) { visit(next); }
+                    else if (on_stack.test(next)) {
+                        low[rule] = std::min(low[rule], index[next]);
+                    }
+                    continue;
+                }
+
+                frames.pop_back();
+                if (!frames.empty()) {
+                    auto &parent = low[frames.back().first];
+                    parent = std::min(parent, low[rule]);
+                }
+                if (low[rule] == index[rule]) {
+                    emit(rule, stack, on_stack, deps, offs);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Moves the component of the root from the stack
+     */
+    void emit(std::size_t root, std::vector<std::size_t> &stack,
+              bitmap_t &on_stack, const std::vector<std::size_t> &deps,
+              const std::vector<std::size_t> &offs) {
+        auto first = m_rules.size();
+        std::size_t rule;
+        do {
+            rule = stack.back();
+            stack.pop_back();
+            on_stack.reset(rule);
+            m_rules.push_back(rule);
+        } while (rule != root);
+        std::sort(m_rules.begin() + first, m_rules.end());
+
+        bool cyclic = m_rules.size() - first > 1 ||
+                std::find(deps.begin() + offs[root],
+                          deps.begin() + offs[root + 1], root) !=
+                deps.begin() + offs[root + 1];
+        m_offs.push_back(m_rules.size());
+        m_cyclic.push_back(cyclic);
+    }
+};
+
+}
+
+#endif // STRATA_HPP
@@ -0,0 +1,91 @@
+#ifndef SYMBOLS_HPP
+#define SYMBOLS_HPP
+
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace xpertium {
+
+/**
+ * Dense ID of an interned value
+ */
+using sym_t = std::uint32_t;
+
+/**
+ * Invalid symbol (the value isn't known by the knowledge database)
+ */
+constexpr sym_t no_sym = std::numeric_limits<sym_t>::max();
+
+/**
+ * This class maps values of the knowledge database to dense integer IDs, so
+ * the engine compares facts as integers and turns them back into values only
+ * for the dialogue and the tracer
+ */
+template <typename val_t>
+class symbols_t {
+    std::unordered_map<val_t, sym_t> m_ids;
+    std::vector<const val_t *> m_vals;
+public:
+    /**
+     * @brief Constructor
+     */
+    symbols_t() {}
+
+    /**
+     * @brief Deletes a copy constructor
+     */
+    symbols_t(const symbols_t<val_t> &) = delete;
+
+    /**
+     * @brief Move constructor
+     */
+    symbols_t(symbols_t &&) = default;
+
+    /**
+     * @brief Deletes a copy assignment
+     */
+    symbols_t<val_t> &operator=(const symbols_t<val_t> &) = delete;
+
+    /**
+     * @brief Move assignment
+     */
+    symbols_t<val_t> &operator=(symbols_t &&) = default;
+
+    /**
+     * @brief Returns an ID of the value and registers it if it's new
+     * @param value Value
+     * @return Symbol ID
+     */
+    sym_t intern(const val_t &value) {
+        auto res = m_ids.emplace(value, static_cast<sym_t>(m_vals.size()));
+        if (res.second) { m_vals.push_back(&res.first->first); }
+        return res.first->second;
+    }
+
+    /**
+     * @brief Returns an ID of the value
+     * @param value Value
+     * @return Symbol ID or `no_sym` if the value isn't interned
+     */
+    sym_t find(const val_t &value) const {
+        auto it = m_ids.find(value);
+        return it != m_ids.end() ? it->second : no_sym;
+    }
+
+    /**
+     * @brief Returns a value by its ID
+     * @param id Symbol ID
+     */
+    const val_t &value(sym_t id) const { return *m_vals[id]; }
+
+    /**
+     * @brief Returns a number of interned values
+     */
+    std::size_t size() const { return m_vals.size(); }
+};
+
+}
+
+#endif // SYMBOLS_HPP
@@ -22,7 +22,7 @@ public:
     phase_t &operator=(phase_t &) = default;
     phase_t &operator=(phase_t &&) = default;
 
-    const std::string &name() { return m_name; }
+    const std::string &name() const { return m_name; }
 };
 
 /**
@@ -41,13 +41,13 @@ public:
     term_t<val_t> &operator=(term_t<val_t> &) = default;
     term_t<val_t> &operator=(term_t &&) = default;
 
-    phase_t *find_phase(const std::string &name) {
+    const phase_t *find_phase(const std::string &name) const {
         auto it = std::find_if(m_phases.begin(), m_phases.end(),
-                               [&name](auto obj) {
+                               [&name](const auto &obj) {
             return obj.name().compare(name) == 0;
         });
         if (it == m_phases.end()) { return nullptr; }
-        return *it;
+        return &*it;
     }
 
     /**
@@ -6,6 +6,7 @@
 #include <iostream>
 #include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace xpertium {
@@ -56,6 +57,39 @@ private:
     }
 };
 
+/**
+ * This class keeps a trace to replay it into another tracer, e.g. the trace
+ * of a speculative proof which was accepted
+ */
+template <typename val_t>
+class trace_buffer_t : public base_tracer_t<val_t> {
+    // Facts are kept with `nullptr` rules
+    std::vector<std::pair<const rule_t<val_t> *, val_t>> m_trace;
+public:
+    virtual void push_fact(val_t fact) override {
+        m_trace.emplace_back(nullptr, std::move(fact));
+    }
+
+    virtual void push_rule(const rule_t<val_t> *rule, val_t out) override {
+        m_trace.emplace_back(rule, std::move(out));
+    }
+
+    virtual void print() override {}
+
+    virtual void clear() override { m_trace.clear(); }
+
+    /**
+     * @brief Pushes the kept trace to the tracer
+     * @param tracer Tracer
+     */
+    void replay(base_tracer_t<val_t> &tracer) const {
+        for (const auto &[rule, val] : m_trace) {
+            if (rule) { tracer.push_rule(rule, val); }
+            else { tracer.push_fact(val); }
+        }
+    }
+};
+
 }
 
 #endif // TRACER_HPP
@@ -0,0 +1,145 @@
+#include "dialog.hpp"
+#include "expert.hpp"
+#include "pool.hpp"
+#include "tracer.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+using namespace xpertium;
+
+using sval_t = std::string;
+
+/**
+ * Dialogue of the benchmark, the generated KB has no questions
+ */
+class silent_dialog_t : public base_dialog_t<sval_t> {
+    mutable std::ostream m_null{nullptr};
+public:
+    sval_t ask(const quest_t<sval_t> *) const override { return sval_t(); }
+    std::ostream &print() const override { return m_null; }
+};
+
+/**
+ * Tracer which keeps a hash of the trace to compare engines
+ */
+class hash_tracer_t : public base_tracer_t<sval_t> {
+    std::size_t m_hash = 0;
+public:
+    void push_fact(sval_t fact) override { mix(fact); }
+    void push_rule(const rule_t<sval_t> *rule, sval_t out) override {
+        mix(rule->id());
+        mix(out);
+    }
+    void print() override {}
+    void clear() override { m_hash = 0; }
+
+    std::size_t hash() const { return m_hash; }
+private:
+    void mix(const sval_t &str) {
+        m_hash = m_hash * 31 + std::hash<sval_t>()(str);
+    }
+};
+
+/**
+ * @brief Generates layers of rules, every rule is a conjunction of
+ *        disjunctions of facts from lower layers
+ * @param nrules Number of rules, at least `4 * nlayers`
+ * @param nlayers Number of layers
+ * @param init Initial facts
+ * @return Knowledge database
+ */
+static kb_t<sval_t> *generate(std::size_t nrules, std::size_t nlayers,
+                              std::vector<sval_t> &init) {
+    std::mt19937 rng(1);
+    auto symbols = new symbols_t<sval_t>();
+    auto rules = new rules_t<sval_t>();
+    auto width = nrules / nlayers;
+
+    std::vector<sym_t> facts;
+    for (std::size_t i = 0; i < width / 4; ++i) {
+        init.push_back("f" + std::to_string(facts.size()));
+        facts.push_back(symbols->intern(init.back()));
+    }
+    for (std::size_t layer = 0; layer < nlayers; ++layer) {
+        auto lower = facts.size();
+        for (std::size_t i = 0; i < width / 2; ++i) {
+            auto name = "f" + std::to_string(facts.size());
+            facts.push_back(symbols->intern(name));
+        }
+        for (std::size_t i = 0; i < width; ++i) {
+            exps_t<sval_t> conj;
+            for (int j = 0; j < 2; ++j) {
+                exps_t<sval_t> disj;
+                for (int k = 0; k < 3; ++k) {
+                    disj.emplace_back(_fact<sval_t>(facts[rng() % lower]));
+                }
+                conj.emplace_back(_or(std::move(disj)));
+            }
+            auto out = facts[lower + rng() % (width / 2)];
+            rules->emplace_back(std::make_unique<rule_t<sval_t>>(
+                "r" + std::to_string(rules->size()), _and(std::move(conj)),
+                nullptr, rules->size() % 1000 == 0, out));
+        }
+    }
+
+    auto kb = new kb_t<sval_t>("bench");
+    kb->load(symbols, new quests_t<sval_t>(), rules);
+    return kb;
+}
+
+int main(int argc, char **argv) {
+    std::size_t nrules = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                  : 100000;
+    std::size_t threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10)
+                                   : std::thread::hardware_concurrency();
+    // Every layer needs initial facts and outputs of its rules
+    const std::size_t nlayers = 10;
+    if (nrules < 4 * nlayers) {
+        std::cerr << "Number of rules must be at least " << 4 * nlayers
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<sval_t> init;
+    std::unique_ptr<kb_t<sval_t>> kb(generate(nrules, nlayers, init));
+    silent_dialog_t dialog;
+
+    std::size_t ref_hash = 0;
+    std::size_t ref_facts = 0;
+    double ref_time = 0;
+    for (std::size_t n = 0; n <= threads; n = n ? n * 2 : 1) {
+        hash_tracer_t tracer;
+        expert_t<sval_t> expert(kb.get(), dialog, tracer);
+        std::unique_ptr<thread_pool_t> pool(n ? new thread_pool_t(n)
+                                              : nullptr);
+        expert.reset(&init);
+
+        auto start = std::chrono::steady_clock::now();
+        auto targets = pool ? expert.saturate(*pool) : expert.saturate();
+        std::chrono::duration<double, std::milli> time =
+                std::chrono::steady_clock::now() - start;
+
+        // The serial engine is the reference of results, a single worker
+        // is the reference of the scaling
+        auto facts = expert.session().facts().size();
+        if (!n) {
+            ref_hash = tracer.hash();
+            ref_facts = facts;
+        }
+        if (n == 1) { ref_time = time.count(); }
+        std::cout << (n ? std::to_string(n) + " threads" : "serial")
+                  << ": " << time.count() << " ms";
+        if (n) { std::cout << ", speedup " << ref_time / time.count(); }
+        std::cout << ", facts " << facts << ", targets " << targets.size()
+                  << (tracer.hash() == ref_hash && facts == ref_facts
+                          ? "" : ", TRACE DIFFERS") << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,687 @@
+#include "async.hpp"
+#include "batch.hpp"
+#include "dialog.hpp"
+#include "expert.hpp"
+#include "image.hpp"
+#include "kb_parser.hpp"
+#include "tracer.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace xpertium;
+
+using sval_t = std::string;
+
+/**
+ * Dialogue which picks an answer by a hash of the question ID, so every
+ * engine gets the same answers, and keeps the messages of the consultation
+ */
+class hash_dialog_t : public base_dialog_t<sval_t> {
+    std::size_t m_salt;
+    mutable std::ostringstream m_out;
+public:
+    /**
+     * @brief Constructor
+     * @param salt Salt of the hash, dialogues with other salts can answer
+     *             differently
+     */
+    explicit hash_dialog_t(std::size_t salt = 0) : m_salt{salt} {}
+
+    sval_t ask(const quest_t<sval_t> *quest) const override {
+        return pick(quest, m_salt).id();
+    }
+    std::ostream &print() const override { return m_out; }
+
+    std::string messages() const { return m_out.str(); }
+
+    /**
+     * @brief Returns the answer of a dialogue with the salt
+     */
+    static const ans_t<sval_t> &pick(const quest_t<sval_t> *quest,
+                                     std::size_t salt) {
+        const auto &answers = quest->answers();
+        auto hash = std::hash<sval_t>()(quest->id()) + salt;
+        return answers[hash % answers.size()];
+    }
+};
+
+/**
+ * Tracer which keeps the whole trace as a string
+ */
+class string_tracer_t : public base_tracer_t<sval_t> {
+    std::string m_trace;
+public:
+    void push_fact(sval_t fact) override { m_trace += "+" + fact; }
+    void push_rule(const rule_t<sval_t> *rule, sval_t out) override {
+        m_trace += " " + rule->id() + ">" + out + " ";
+    }
+    void print() override {}
+    void clear() override { m_trace.clear(); }
+
+    const std::string &trace() const { return m_trace; }
+};
+
+/**
+ * Parameters of a generated knowledge database
+ */
+struct gen_params_t {
+    std::size_t rules = 60;
+    std::size_t facts = 25;
+    std::size_t quests = 3;
+    bool negations = true;
+    /// Can answers of different questions give the same fact?
+    bool shared_answers = true;
+};
+
+/**
+ * @brief Generates a random logical expression
+ * @param rng Random generator
+ * @param facts Interned facts
+ * @param negations Can the expression contain negations?
+ * @param depth Largest depth of the expression
+ * @return Expression
+ */
+static exp_t<sval_t> *generate_exp(std::mt19937 &rng,
+                                   const std::vector<sym_t> &facts,
+                                   bool negations, int depth) {
+    auto kind = rng() % 10;
+    if (!depth || kind < 4 || (kind == 4 && !negations)) {
+        return _fact<sval_t>(facts[rng() % facts.size()]);
+    }
+    if (kind == 4) {
+        return _not(generate_exp(rng, facts, negations, depth - 1));
+    }
+
+    exps_t<sval_t> exps;
+    for (auto n = 1 + rng() % 3; n; --n) {
+        exps.emplace_back(generate_exp(rng, facts, negations, depth - 1));
+    }
+    if (kind < 8) { return _and(std::move(exps)); }
+    return _or(std::move(exps));
+}
+
+/**
+ * @brief Generates a knowledge database with facts `f0`, `f1`, ... The first
+ *        rules ask questions, the others derive facts and some of them are
+ *        targets
+ * @param seed Seed of the random generator
+ * @param params Parameters of the knowledge database
+ * @return Knowledge database
+ */
+static kb_t<sval_t> *generate(unsigned seed, const gen_params_t &params) {
+    std::mt19937 rng(seed);
+    auto symbols = new symbols_t<sval_t>();
+    auto quests = new quests_t<sval_t>();
+    auto rules = new rules_t<sval_t>();
+
+    std::vector<sym_t> facts;
+    for (std::size_t i = 0; i < params.facts; ++i) {
+        facts.push_back(symbols->intern("f" + std::to_string(i)));
+    }
+    std::vector<sym_t> unused = facts;
+    for (std::size_t i = 0; i < params.quests; ++i) {
+        answers_t<sval_t> answers;
+        for (auto n = 2 + rng() % 2; n; --n) {
+            auto fact = facts[rng() % facts.size()];
+            if (!params.shared_answers) {
+                auto pos = rng() % unused.size();
+                fact = unused[pos];
+                unused.erase(unused.begin() + pos);
+            }
+            answers.emplace_back(symbols->value(fact),
+                                 "a" + std::to_string(answers.size()), fact);
+        }
+        auto id = "q" + std::to_string(i);
+        quests->push_back(std::make_unique<quest_t<sval_t>>(
+            id, id + "?", std::move(answers)));
+    }
+    for (std::size_t i = 0; i < params.rules; ++i) {
+        auto id = "r" + std::to_string(i);
+        auto exp = generate_exp(rng, facts, params.negations, 3);
+        if (i < params.quests) {
+            rules->emplace_back(std::make_unique<rule_t<sval_t>>(
+                id, exp, (*quests)[i].get(), false));
+        } else {
+            auto out = facts[rng() % facts.size()];
+            rules->emplace_back(std::make_unique<rule_t<sval_t>>(
+                id, exp, nullptr, rng() % 20 == 0, out));
+        }
+    }
+
+    auto kb = new kb_t<sval_t>("rand" + std::to_string(seed));
+    kb->load(symbols, quests, rules);
+    return kb;
+}
+
+/**
+ * @brief Returns initial facts of the consultations
+ */
+static const std::vector<std::vector<sval_t>> &inits() {
+    static const std::vector<std::vector<sval_t>> res{
+        {}, {"f0"}, {"f0", "f5", "f9"}};
+    return res;
+}
+
+/**
+ * @brief Reports a mismatch of two engines
+ * @param kb Knowledge database
+ * @param what Description of the mismatch
+ * @return 1
+ */
+static int mismatch(const kb_t<sval_t> &kb, const std::string &what) {
+    std::cerr << kb.name() << ": " << what << std::endl;
+    return 1;
+}
+
+/**
+ * @brief Runs the direct output twice on one session
+ * @param kb Knowledge database
+ * @param mode Strategy of the direct output
+ * @param init Initial facts
+ * @param target Target fact (`nullptr` for any target)
+ * @return Results, messages and the trace
+ */
+static std::string run_direct(const kb_t<sval_t> *kb, direct_mode_t mode,
+                              const std::vector<sval_t> &init,
+                              const sval_t *target) {
+    hash_dialog_t dialog;
+    string_tracer_t tracer;
+    expert_t<sval_t> expert(kb, dialog, tracer);
+    expert.direct_mode(mode);
+    expert.reset(&init);
+    auto first = expert.direct(target);
+    // The second call continues on the same session
+    auto second = expert.direct(target);
+
+    return std::to_string(first) + std::to_string(second) +
+           dialog.messages() + tracer.trace();
+}
+
+/**
+ * @brief Checks that the Rete network fires the rules of the incremental
+ *        mode in the same order
+ * @param kb Knowledge database
+ * @return Number of mismatches
+ */
+static int check_rete(const kb_t<sval_t> *kb) {
+    int res = 0;
+    std::vector<sval_t> targets{"f1", "f2", "f3", "f7"};
+    for (const auto &init : inits()) {
+        res += run_direct(kb, direct_mode_t::incremental, init, nullptr) !=
+               run_direct(kb, direct_mode_t::rete, init, nullptr) &&
+               mismatch(*kb, "rete differs without a target");
+        for (const auto &target : targets) {
+            res += run_direct(kb, direct_mode_t::incremental, init,
+                              &target) !=
+                   run_direct(kb, direct_mode_t::rete, init, &target) &&
+                   mismatch(*kb, "rete differs for " + target);
+        }
+    }
+
+    return res;
+}
+
+/**
+ * @brief Checks that the asynchronous engine outputs like `expert_t` with
+ *        the Rete network does
+ * @param kb Knowledge database
+ * @return Number of mismatches
+ */
+static int check_async(const kb_t<sval_t> *kb) {
+    int res = 0;
+    std::vector<const char *> targets{nullptr, "f1", "f2", "f3", "f7"};
+    for (int reverse = 0; reverse < 2; ++reverse) {
+        for (const auto &init : inits()) {
+            for (auto name : targets) {
+                if (reverse && !name) { continue; }
+                sval_t target = name ? name : "";
+                auto target_ptr = name ? &target : nullptr;
+
+                hash_dialog_t dialog;
+                string_tracer_t tracer;
+                expert_t<sval_t> expert(kb, dialog, tracer);
+                expert.direct_mode(direct_mode_t::rete);
+                expert.reset(&init);
+                auto result = reverse ? expert.reverse(target)
+                                      : expert.direct(target_ptr);
+                auto ref = std::to_string(result) + dialog.messages() +
+                           tracer.trace();
+
+                hash_dialog_t async_dialog;
+                string_tracer_t async_tracer;
+                std::ostringstream out;
+                async_expert_t<sval_t> async(kb, async_tracer, out);
+                async.reset(&init);
+                auto quest = reverse ? async.reverse(target)
+                                     : async.direct(target_ptr);
+                while (quest) { quest = async.answer(async_dialog.ask(quest)); }
+                auto cur = std::to_string(async.result()) + out.str() +
+                           async_tracer.trace();
+
+                res += ref != cur &&
+                       mismatch(*kb, std::string("async ") +
+                                (reverse ? "reverse" : "direct") +
+                                " differs for " + (name ? name : "any"));
+            }
+        }
+    }
+
+    return res;
+}
+
+/**
+ * @brief Checks that the saturation derives in every row the targets which
+ *        the direct output derives when it's restarted until no target is
+ *        left, and that the batch derives the same targets. The KB must
+ *        have no negations
+ * @param kb Knowledge database
+ * @param seed Seed of the rows
+ * @return Number of mismatches
+ */
+static int check_batch(const kb_t<sval_t> *kb, unsigned seed) {
+    const std::size_t rows = 100;
+    auto nfacts = kb->symbols()->size();
+    std::mt19937 rng(seed);
+    fact_batch_t init(nfacts, rows);
+    fact_batch_t answers(nfacts, rows);
+    std::vector<std::vector<sval_t>> row_init(rows);
+    for (std::size_t row = 0; row < rows; ++row) {
+        for (sym_t fact = 0; fact < nfacts; ++fact) {
+            if (rng() % 8 == 0) {
+                init.set(fact, row);
+                row_init[row].push_back(kb->symbols()->value(fact));
+            }
+        }
+        for (const auto &quest : *kb->questions()) {
+            answers.set(hash_dialog_t::pick(quest.get(), row).fact(), row);
+        }
+    }
+    auto targets = batch_expert_t<sval_t>(kb).direct(init, answers);
+
+    int res = 0;
+    for (std::size_t row = 0; row < rows; ++row) {
+        hash_dialog_t dialog(row);
+        string_tracer_t tracer;
+        expert_t<sval_t> expert(kb, dialog, tracer);
+        expert.reset(&row_init[row]);
+        auto saturated = expert.saturate();
+        std::set<sval_t> expected(saturated.begin(), saturated.end());
+
+        hash_dialog_t restarted_dialog(row);
+        expert_t<sval_t> restarted(kb, restarted_dialog, tracer);
+        restarted.direct_mode(direct_mode_t::incremental);
+        restarted.reset(&row_init[row]);
+        while (restarted.direct()) {}
+        std::set<sval_t> reached;
+        std::istringstream messages(restarted_dialog.messages());
+        const std::string prefix = "Result: ";
+        for (std::string line; std::getline(messages, line);) {
+            if (!line.compare(0, prefix.size(), prefix)) {
+                reached.insert(line.substr(prefix.size()));
+            }
+        }
+        res += expected != reached &&
+               mismatch(*kb, "saturation differs in row " +
+                             std::to_string(row));
+
+        std::set<sval_t> derived;
+        for (auto fact : targets.row(row)) {
+            derived.insert(kb->symbols()->value(fact));
+        }
+        res += expected != derived &&
+               mismatch(*kb, "batch differs in row " + std::to_string(row));
+    }
+
+    return res;
+}
+
+/**
+ * @brief Returns a text of the knowledge database to compare loaders. Facts
+ *        are written by values, so loaders can intern them in any order
+ * @param kb Knowledge database
+ * @return Questions and rules with their programs
+ */
+static std::string dump(const kb_t<sval_t> &kb) {
+    const auto &symbols = *kb.symbols();
+    std::ostringstream out;
+    out << kb.name() << "\n";
+    for (const auto &quest : *kb.questions()) {
+        out << quest->id() << " " << quest->question();
+        for (const auto &ans : quest->answers()) {
+            out << " " << ans.id() << ":" << ans.title() << ":"
+                << symbols.value(ans.fact());
+        }
+        out << "\n";
+    }
+    for (const auto &rule : *kb.rules()) {
+        out << rule->id() << " "
+            << (rule->question() ? rule->question()->id() : "-") << " "
+            << rule->target() << " "
+            << (rule->out() != no_sym ? symbols.value(rule->out()) : "-");
+        const auto &prog = rule->program();
+        for (std::size_t ip = 0; ip < prog.size(); ++ip) {
+            const auto &in = prog.code()[ip];
+            out << " " << static_cast<int>(in.op) << ":";
+            if (in.op == op_t::fact || in.op == op_t::no_fact) {
+                out << symbols.value(in.arg);
+            } else { out << in.arg; }
+        }
+        out << "\n";
+    }
+
+    return out.str();
+}
+
+/**
+ * @brief Checks that a KB loaded from its image has the same content and
+ *        gives the same direct output
+ * @param kb Knowledge database
+ * @return Number of mismatches
+ */
+static int check_image(const kb_t<sval_t> *kb) {
+    auto path = (std::filesystem::temp_directory_path() /
+                 ("check_" + kb->name() + ".img")).string();
+    kb_t<sval_t> *loaded = nullptr;
+    auto saved = save_image(*kb, path) && load_image(path, &loaded);
+    std::filesystem::remove(path);
+    if (!saved) { return mismatch(*kb, "image isn't loaded"); }
+    std::unique_ptr<kb_t<sval_t>> owner(loaded);
+
+    int res = dump(*kb) != dump(*loaded) &&
+              mismatch(*kb, "image differs");
+    for (const auto &init : inits()) {
+        for (auto mode : {direct_mode_t::scan, direct_mode_t::rete}) {
+            res += run_direct(kb, mode, init, nullptr) !=
+                   run_direct(loaded, mode, init, nullptr) &&
+                   mismatch(*kb, "image gives another direct output");
+        }
+    }
+
+    return res;
+}
+
+/**
+ * This class writes logical expressions in the XML format of the KB parser
+ */
+class xml_writer_t : public exp_visitor_t<sval_t> {
+    const symbols_t<sval_t> &m_symbols;
+    std::ostream &m_out;
+public:
+    /**
+     * @brief Constructor
+     * @param symbols Symbols of facts
+     * @param out Output stream
+     */
+    xml_writer_t(const symbols_t<sval_t> &symbols, std::ostream &out) :
+        m_symbols{symbols}, m_out{out} {}
+
+    void visit(const exp_t<sval_t> &) override {}
+    void visit(const fact_t<sval_t> &exp) override {
+        m_out << "<exp type=\"fact\" value=\"" << m_symbols.value(exp.value())
+              << "\"/>";
+    }
+    void visit(const not_t<sval_t> &exp) override {
+        m_out << "<exp type=\"not\">";
+        exp.exp()->accept(*this);
+        m_out << "</exp>";
+    }
+    void visit(const and_t<sval_t> &exp) override {
+        write("and", exp.exps());
+    }
+    void visit(const or_t<sval_t> &exp) override { write("or", exp.exps()); }
+
+    /**
+     * @brief Writes the knowledge database
+     * @param kb Knowledge database
+     * @param out Output stream
+     */
+    static void write(const kb_t<sval_t> &kb, std::ostream &out) {
+        const auto &symbols = *kb.symbols();
+        out << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+            << "<kb name=\"" << kb.name() << "\">\n<questions>\n";
+        for (const auto &quest : *kb.questions()) {
+            out << "<question id=\"" << quest->id() << "\" q=\""
+                << quest->question() << "\">\n<answers>\n";
+            for (const auto &ans : quest->answers()) {
+                out << "<answer id=\"" << ans.id() << "\" title=\""
+                    << ans.title() << "\"/>\n";
+            }
+            out << "</answers>\n</question>\n";
+        }
+        out << "</questions>\n<rules>\n";
+        xml_writer_t writer(symbols, out);
+        for (const auto &rule : *kb.rules()) {
+            out << "<rule id=\"" << rule->id() << "\"";
+            if (rule->question()) {
+                out << " quest_id=\"" << rule->question()->id() << "\"";
+            }
+            if (rule->out() != no_sym) {
+                out << " out=\"" << symbols.value(rule->out()) << "\"";
+            }
+            if (rule->target()) { out << " target=\"true\""; }
+            out << ">";
+            rule->exp()->accept(writer);
+            out << "</rule>\n";
+        }
+        out << "</rules>\n</kb>\n";
+    }
+private:
+    void write(const char *type, const exps_t<sval_t> &exps) {
+        m_out << "<exp type=\"" << type << "\">";
+        for (const auto &exp : exps) { exp->accept(*this); }
+        m_out << "</exp>";
+    }
+};
+
+/**
+ * @brief Checks that the parser reads a KB written in XML back, that the
+ *        parsed KB gives the same direct output and that the parallel
+ *        parser gives the same KB
+ * @param kb Knowledge database
+ * @return Number of mismatches
+ */
+static int check_parser(const kb_t<sval_t> *kb) {
+    auto path = (std::filesystem::temp_directory_path() /
+                 ("check_" + kb->name() + ".xml")).string();
+    {
+        std::ofstream out(path);
+        xml_writer_t::write(*kb, out);
+    }
+    kb_t<sval_t> *parsed = nullptr;
+    if (!load_kb(path, &parsed)) {
+        std::filesystem::remove(path);
+        return mismatch(*kb, "XML isn't parsed");
+    }
+    std::unique_ptr<kb_t<sval_t>> owner(parsed);
+
+    int res = dump(*kb) != dump(*parsed) &&
+              mismatch(*kb, "parsed KB differs");
+    for (const auto &init : inits()) {
+        res += run_direct(kb, direct_mode_t::rete, init, nullptr) !=
+               run_direct(parsed, direct_mode_t::rete, init, nullptr) &&
+               mismatch(*kb, "parsed KB gives another direct output");
+    }
+
+    // Rules are split into more chunks than threads, so every pool reads
+    // the rules in a different set of chunks
+    static thread_pool_t pools[] = {
+        thread_pool_t(1), thread_pool_t(2), thread_pool_t(3), thread_pool_t(8)
+    };
+    for (auto &pool : pools) {
+        kb_t<sval_t> *chunked = nullptr;
+        if (!load_kb(path, &chunked, pool)) {
+            res += mismatch(*kb, "XML isn't parsed in parallel");
+            continue;
+        }
+        std::unique_ptr<kb_t<sval_t>> chunked_owner(chunked);
+        res += dump(*parsed) != dump(*chunked) &&
+               mismatch(*kb, "parallel parser differs");
+    }
+    std::filesystem::remove(path);
+
+    return res;
+}
+
+/**
+ * @brief Checks that the per-session cache of the discrimination network
+ *        evaluates rules like their programs while facts are added
+ * @param kb Knowledge database
+ * @param seed Seed of the sequences of facts
+ * @return Number of mismatches
+ */
+static int check_cache(const kb_t<sval_t> *kb, unsigned seed) {
+    int res = 0;
+    std::mt19937 rng(seed);
+    const auto &rules = *kb->rules();
+    session_t<sval_t> session(kb);
+    for (int round = 0; round < 3; ++round) {
+        session.reset();
+        for (std::size_t step = 0; step < kb->symbols()->size(); ++step) {
+            session.facts().insert(rng() % kb->symbols()->size());
+            for (std::size_t idx = 0; idx < rules.size(); ++idx) {
+                res += session.is(idx) != rules[idx]->is(session.facts()) &&
+                       mismatch(*kb, "cache differs for " + rules[idx]->id());
+            }
+        }
+    }
+
+    return res;
+}
+
+/**
+ * @brief Checks that the mode reaches the targets of the incremental one,
+ *        the KB must have no negations
+ * @param kb Knowledge database
+ * @param mode Strategy of the direct output
+ * @param name Name of the strategy
+ * @return Number of mismatches
+ */
+static int check_reached(const kb_t<sval_t> *kb, direct_mode_t mode,
+                         const std::string &name) {
+    int res = 0;
+    for (const auto &init : inits()) {
+        for (std::size_t fact = 0; fact < kb->symbols()->size(); ++fact) {
+            auto target = kb->symbols()->value(fact);
+            bool reached[2];
+            for (int idx = 0; idx < 2; ++idx) {
+                hash_dialog_t dialog;
+                string_tracer_t tracer;
+                expert_t<sval_t> expert(kb, dialog, tracer);
+                expert.direct_mode(idx ? mode : direct_mode_t::incremental);
+                expert.reset(&init);
+                reached[idx] = expert.direct(&target);
+            }
+            res += reached[0] != reached[1] &&
+                   mismatch(*kb, name + " differs for " + target);
+        }
+    }
+
+    return res;
+}
+
+/**
+ * @brief Checks that the saturation which evaluates rounds by the pool
+ *        gives the same targets, messages and trace as the serial one
+ * @param kb Knowledge database
+ * @param pool Thread pool
+ * @return Number of mismatches
+ */
+static int check_saturate(const kb_t<sval_t> *kb, thread_pool_t &pool) {
+    int res = 0;
+    for (const auto &init : inits()) {
+        std::string runs[2];
+        for (int idx = 0; idx < 2; ++idx) {
+            hash_dialog_t dialog;
+            string_tracer_t tracer;
+            expert_t<sval_t> expert(kb, dialog, tracer);
+            expert.reset(&init);
+            auto targets = idx ? expert.saturate(pool) : expert.saturate();
+            for (const auto &target : targets) { runs[idx] += target + ";"; }
+            runs[idx] += dialog.messages() + tracer.trace();
+        }
+        res += runs[0] != runs[1] &&
+               mismatch(*kb, "saturation by the pool differs");
+    }
+
+    return res;
+}
+
+/**
+ * @brief Checks that the speculative reverse output proves every target
+ *        which the serial one proves
+ * @param kb Knowledge database
+ * @param pool Thread pool
+ * @return Number of mismatches
+ */
+static int check_speculative(const kb_t<sval_t> *kb, thread_pool_t &pool) {
+    int res = 0;
+    for (const auto &init : inits()) {
+        for (std::size_t fact = 0; fact < kb->symbols()->size(); ++fact) {
+            auto target = kb->symbols()->value(fact);
+            hash_dialog_t dialog;
+            string_tracer_t tracer;
+            expert_t<sval_t> expert(kb, dialog, tracer);
+            expert.reset(&init);
+            auto serial = expert.reverse(target);
+            expert.reset(&init);
+            auto speculative = expert.reverse_speculative(target, pool);
+            res += serial && !speculative &&
+                   mismatch(*kb, "speculative misses " + target);
+        }
+    }
+
+    return res;
+}
+
+int main(int argc, char **argv) {
+    unsigned nseeds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 30;
+    thread_pool_t pool(4);
+
+    int failures = 0;
+    for (unsigned seed = 1; seed <= nseeds; ++seed) {
+        std::unique_ptr<kb_t<sval_t>> kb(generate(seed, gen_params_t()));
+        failures += check_rete(kb.get());
+        failures += check_async(kb.get());
+        failures += check_image(kb.get());
+        failures += check_parser(kb.get());
+        failures += check_cache(kb.get(), seed);
+
+        // Negations make the order of rules matter, and a batch keeps
+        // answers of rows by facts, not by questions
+        gen_params_t monotonic;
+        monotonic.negations = false;
+        monotonic.shared_answers = false;
+        kb.reset(generate(seed, monotonic));
+        failures += check_batch(kb.get(), seed);
+        failures += check_reached(kb.get(), direct_mode_t::stratified,
+                                  "stratified");
+        failures += check_reached(kb.get(), direct_mode_t::magic, "magic");
+
+        // Rounds are evaluated by the pool only if they have enough rules
+        gen_params_t large;
+        large.rules = 4000;
+        large.facts = 200;
+        kb.reset(generate(seed, large));
+        failures += check_saturate(kb.get(), pool);
+
+        // Without questions the speculation isn't replaced by the serial proof
+        gen_params_t question_free;
+        question_free.quests = 0;
+        kb.reset(generate(seed, question_free));
+        failures += check_speculative(kb.get(), pool);
+    }
+
+    std::cout << nseeds << " random KBs, " << failures << " mismatches"
+              << std::endl;
+    return failures ? 1 : 0;
+}
@@ -1,125 +1,444 @@
 #ifndef KB_PARSER_HPP
 #define KB_PARSER_HPP
 
+#include "image.hpp"
 #include "kb.hpp"
-#include "tinyxml2.h"
+#include "pool.hpp"
+#include "xml_reader.hpp"
 
-#include <algorithm>
 #include <cstring>
+#include <fstream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace xpertium {
 
-using namespace tinyxml2;
-
 using sval_t = std::string;
 using sans_t = ans_t<sval_t>;
 using squest_t = quest_t<sval_t>;
 using srule_t = rule_t<sval_t>;
+using ssymbols_t = symbols_t<sval_t>;
 
 namespace internal {
 
-std::vector<sans_t> parse_answers(XMLElement *element) {
-    std::vector<sans_t> as;
-    auto e = element->FirstChildElement("answer");
+/**
+ * Rule which is read and compiled but isn't linked with its question yet
+ */
+struct parsed_rule_t {
+    std::string id;
+    std::string quest_id;
+    bool has_quest;
+    bool target;
+    sym_t out;
+    std::unique_ptr<exp_t<sval_t>> exp;
+    program_t prog;
+};
+
+/**
+ * This class builds questions and rules from events of the XML reader, so
+ * the whole document is never kept in memory. Questions are resolved by
+ * `link()` after reading, so a rule can refer to a question defined after it
+ */
+class kb_builder_t {
+    /**
+     * Expression which is being read
+     */
+    struct exp_frame_t {
+        std::string type;
+        sym_t value;
+        exps_t<sval_t> exps;
+    };
+
+    enum class section_t { none, questions, rules };
+
+    ssymbols_t *m_symbols;
+    quests_t<sval_t> *m_quests;
+    arena_t *m_arena;
+    section_t m_section;
+
+    std::string m_id, m_text;
+    answers_t<sval_t> m_answers;
+    std::string m_quest_ref, m_out;
+    bool m_has_quest = false, m_has_out = false, m_target = false;
+    std::unique_ptr<exp_t<sval_t>> m_exp;
+    std::vector<exp_frame_t> m_frames;
+public:
+    std::string name;
+    std::vector<parsed_rule_t> rules;
 
-    for(; e != nullptr; e = e->NextSiblingElement("answer")) {
-        sans_t a(e->Attribute("id"), e->Attribute("title"));
-        as.push_back(a);
+    /**
+     * @brief Constructor
+     * @param symbols Symbol table
+     * @param quests Output questions
+     * @param arena Arena of rules and expressions (`nullptr` - heap)
+     * @param in_rules Events come from inside of the `rules` element
+     */
+    kb_builder_t(ssymbols_t *symbols, quests_t<sval_t> *quests,
+                 arena_t *arena, bool in_rules = false) :
+        m_symbols{symbols}, m_quests{quests}, m_arena{arena},
+        m_section{in_rules ? section_t::rules : section_t::none} {}
+
+    /**
+     * @brief Reads the rest of the document
+     * @return False if the document is malformed
+     */
+    bool build(xml_reader_t &reader) {
+        for (;;) {
+            auto event = reader.next();
+            if (event == xml_reader_t::event_t::eof) { return true; }
+            if (!handle(reader, event)) { return false; }
+        }
     }
 
-    return as;
-}
+    /**
+     * @brief Handles the event of the reader
+     * @return False if the document is malformed
+     */
+    bool handle(const xml_reader_t &reader, xml_reader_t::event_t event) {
+        switch (event) {
+        case xml_reader_t::event_t::start: return start(reader);
+        case xml_reader_t::event_t::end:
+            return end(reader.name(), reader.depth() + 1);
+        default: return false;
+        }
+    }
 
-quests_t<sval_t> *parse_questions(XMLElement *element) {
-    auto qs = new quests_t<sval_t>();
+    /**
+     * @brief Creates rules and links them with questions. Rules and their
+     *        programs are placed in the arena one after another
+     */
+    rules_t<sval_t> *link() {
+        id_index_t<squest_t> quests(*m_quests, &squest_t::id);
+        auto res = new rules_t<sval_t>();
+        res->reserve(rules.size());
+        for (auto &rule : rules) {
+            auto quest = rule.has_quest ? quests.find(rule.quest_id)
+                                        : nullptr;
+            if (m_arena) { rule.prog.store(*m_arena); }
+            res->emplace_back(new (m_arena) srule_t(
+                                  rule.id, rule.exp.release(),
+                                  std::move(rule.prog), quest, rule.target,
+                                  rule.out));
+        }
+        rules.clear();
 
-    if (!element) { return qs; }
+        return res;
+    }
+private:
+    bool start(const xml_reader_t &reader) {
+        const auto &tag = reader.name();
+        auto depth = reader.depth();
 
-    auto e = element->FirstChildElement("question");
+        if (depth == 1) {
+            auto kb_name = reader.attribute("name");
+            if (!kb_name) { return false; }
+            name = kb_name;
+        } else if (depth == 2) {
+            if (tag == "questions") { m_section = section_t::questions; }
+            else if (tag == "rules") { m_section = section_t::rules; }
+        } else if (m_section == section_t::questions) {
+            return start_question(reader, tag, depth);
+        } else if (m_section == section_t::rules) {
+            return start_rule(reader, tag, depth);
+        }
 
-    for(; e != nullptr; e = e->NextSiblingElement("question")) {
-        auto answers = parse_answers(e->FirstChildElement("answers"));
-        auto q = std::make_unique<squest_t>(
-                    e->Attribute("id"),
-                    e->Attribute("q"),
-                    std::move(answers));
-        qs->push_back(std::move(q));
+        return true;
     }
 
-    return qs;
-}
+    bool start_question(const xml_reader_t &reader, const std::string &tag,
+                        std::size_t depth) {
+        if (depth == 3 && tag == "question") {
+            auto id = reader.attribute("id");
+            auto text = reader.attribute("q");
+            if (!id || !text) { return false; }
+            m_id = id;
+            m_text = text;
+            m_answers.clear();
+        } else if (tag == "answer") {
+            if (depth != 5 || reader.parent() != "answers") { return false; }
+            auto id = reader.attribute("id");
+            auto title = reader.attribute("title");
+            if (!id || !title) { return false; }
+            m_answers.emplace_back(id, title, m_symbols->intern(id));
+        }
+
+        return true;
+    }
+
+    bool start_rule(const xml_reader_t &reader, const std::string &tag,
+                    std::size_t depth) {
+        if (depth == 3 && tag == "rule") {
+            auto id = reader.attribute("id");
+            if (!id) { return false; }
+            m_id = id;
+            auto quest_id = reader.attribute("quest_id");
+            m_has_quest = quest_id;
+            m_quest_ref = quest_id ? quest_id : "";
+            auto target = reader.attribute("target");
+            m_target = target && std::strcmp(target, "false") != 0;
+            auto out = reader.attribute("out");
+            m_has_out = out;
+            m_out = out ? out : "";
+            m_exp.reset();
+            m_frames.clear();
+        } else if (depth > 3 && tag == "exp" &&
+                   (m_frames.size() == depth - 4)) {
+            auto type = reader.attribute("type");
+            if (!type) { return false; }
+            exp_frame_t frame{type, no_sym,
+                              exps_t<sval_t>(arena_resource(m_arena))};
+            if (frame.type == "fact") {
+                auto value = reader.attribute("value");
+                if (!value) { return false; }
+                frame.value = m_symbols->intern(value);
+            }
+            m_frames.push_back(std::move(frame));
+        }
+
+        return true;
+    }
+
+    bool end(const std::string &tag, std::size_t depth) {
+        if (depth == 2) {
+            m_section = section_t::none;
+        } else if (m_section == section_t::questions && depth == 3 &&
+                   tag == "question") {
+            m_quests->push_back(std::make_unique<squest_t>(
+                                    m_id, m_text, std::move(m_answers)));
+            m_answers.clear();
+        } else if (m_section == section_t::rules && depth == 3 &&
+                   tag == "rule") {
+            end_rule();
+        } else if (m_section == section_t::rules && tag == "exp" &&
+                   !m_frames.empty() && m_frames.size() == depth - 3) {
+            return end_exp();
+        }
+
+        return true;
+    }
+
+    bool end_exp() {
+        auto frame = std::move(m_frames.back());
+        m_frames.pop_back();
+
+        std::unique_ptr<exp_t<sval_t>> exp;
+        if (frame.type == "fact") {
+            exp.reset(_fact<sval_t>(frame.value, m_arena));
+        } else if (frame.type == "not") {
+            // Like the DOM parser, only the first operand is negated
+            if (frame.exps.empty()) { return false; }
+            exp.reset(_not<sval_t>(frame.exps.front().release(), m_arena));
+        } else if (frame.type == "and") {
+            exp.reset(_and<sval_t>(std::move(frame.exps), m_arena));
+        } else { exp.reset(_or<sval_t>(std::move(frame.exps), m_arena)); }
 
-exp_t<sval_t> *parse_exp(XMLElement *element) {
-    std::string type = element->Attribute("type");
+        if (!m_frames.empty()) {
+            m_frames.back().exps.push_back(std::move(exp));
+        } else if (!m_exp) { m_exp = std::move(exp); }
 
-    if (type.compare("fact") == 0) {
-        return _fact<sval_t>(element->Attribute("value"));
+        return true;
     }
-    if (type.compare("not") == 0) {
-        auto nested_exp = parse_exp(element->FirstChildElement("exp"));
-        return _not<sval_t>(nested_exp);
+
+    void end_rule() {
+        if (!m_exp) { m_exp.reset(new (m_arena) exp_t<sval_t>()); }
+        auto prog = program_t::compile(m_exp.get());
+        // The output is interned after facts of the expression like the DOM
+        // parser did, so symbol IDs don't depend on the parser
+        auto out = m_has_out ? m_symbols->intern(m_out) : no_sym;
+        rules.push_back({m_id, m_quest_ref, m_has_quest, m_target, out,
+                         std::move(m_exp), std::move(prog)});
     }
+};
+
+/**
+ * Part of the `rules` element which is read by a separate thread
+ */
+struct rule_chunk_t {
+    std::size_t begin;         ///< Offset of the first rule
+    std::size_t end = 0;       ///< Offset where reading was stopped
+    bool ok = false;           ///< The chunk ends at the next chunk
+    bool last = false;         ///< The chunk ends at `</rules>`
+    ssymbols_t symbols;        ///< Local symbol table
+    std::vector<parsed_rule_t> rules;
+};
 
-    auto exps = exps_t<sval_t>();
-    auto e = element->FirstChildElement("exp");
-    for(; e != nullptr; e = e->NextSiblingElement("exp")) {
-        auto nested_exp = std::unique_ptr<exp_t<sval_t>>(parse_exp(e));
-        exps.push_back(std::move(nested_exp));
+/**
+ * @brief Returns offsets of `<rule` tags near equal parts of the data
+ */
+inline std::vector<std::size_t> split_rules(std::string_view data,
+                                            std::size_t begin,
+                                            std::size_t parts) {
+    std::vector<std::size_t> offs{begin};
+    for (std::size_t i = 1; i < parts; ++i) {
+        auto pos = std::max(offs.back() + 1,
+                            begin + (data.size() - begin) / parts * i);
+        for (pos = data.find("<rule", pos); pos != std::string_view::npos;
+             pos = data.find("<rule", pos + 1)) {
+            auto next = pos + 5 < data.size() ? data[pos + 5] : '\0';
+            if (std::strchr(" \t\r\n/>", next) && next) { break; }
+        }
+        if (pos == std::string_view::npos) { break; }
+        offs.push_back(pos);
     }
 
-    return type.compare("and") == 0 ?
-                _and<sval_t>(std::move(exps)) : _or<sval_t>(std::move(exps));
+    return offs;
 }
 
-squest_t *find_quest(quests_t<sval_t> *quests, const char *id) {
-    if (!id) { return nullptr; }
-    squest_t *quest = nullptr;
-    auto it = std::find_if(quests->begin(), quests->end(), [id] (auto &obj) {
-        return obj->id().compare(id) == 0;
-    });
-    if (it != quests->end()) { quest = it->get(); }
+/**
+ * @brief Reads rules of the chunk until the next chunk or the end of the
+ *        `rules` element
+ */
+inline void read_chunk(std::string_view data, const std::string &root,
+                       std::size_t next, rule_chunk_t &chunk) {
+    auto part = data.substr(chunk.begin);
+    xml_reader_t reader(part.data(), part.size(), {root, "rules"});
+    // Trees of chunks are rebuilt after symbols are merged, so they aren't
+    // placed in the arena
+    kb_builder_t builder(&chunk.symbols, nullptr, nullptr, true);
+    next -= chunk.begin;
 
-    return quest;
+    for (;;) {
+        auto event = reader.next();
+        if (event == xml_reader_t::event_t::error ||
+                event == xml_reader_t::event_t::eof) {
+            return;
+        }
+        // The next chunk must start exactly at a rule of this element,
+        // otherwise the split point was inside of a comment or CDATA
+        if (reader.tag_offset() >= next) {
+            chunk.ok = event == xml_reader_t::event_t::start &&
+                    reader.depth() == 3 && reader.tag_offset() == next;
+            break;
+        }
+        if (event == xml_reader_t::event_t::end && reader.depth() == 1) {
+            chunk.end = chunk.begin + reader.offset();
+            chunk.ok = chunk.last = true;
+            break;
+        }
+        if (!builder.handle(reader, event)) { return; }
+    }
+    chunk.rules = std::move(builder.rules);
 }
 
-rules_t<sval_t> *parse_rules(XMLElement *element, quests_t<sval_t> *quests) {
-    auto rules = new rules_t<sval_t>();
-    auto e = element->FirstChildElement("rule");
+}
 
-    for(; e != nullptr; e = e->NextSiblingElement("rule")) {
-        auto exp_node = e->FirstChildElement("exp");
-        auto exp = exp_node ? parse_exp(exp_node) : new exp_t<sval_t>();
+/**
+ * @brief Loads the knowledge database from the XML file. The file is read
+ *        by chunks and rules are built while it's being read
+ * @param filename Path of the file
+ * @param kb Output knowledge database
+ * @return False if the file can't be read or it's malformed
+ */
+inline bool load_kb(const std::string &filename, kb_t<std::string> **kb) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) { return false; }
 
-        std::string id = e->Attribute("id");
-        auto quest = find_quest(quests, e->Attribute("quest_id"));
-        auto target_str = e->Attribute("target");
-        bool target = target_str && std::strcmp(target_str, "false") != 0;
-        auto out_ptr = e->Attribute("out");
-        std::string *out = out_ptr ? new std::string(out_ptr) : nullptr;
+    auto arena = std::make_shared<arena_t>();
+    auto symbols = std::make_unique<ssymbols_t>();
+    auto quests = std::make_unique<quests_t<sval_t>>();
+    xml_reader_t reader(in);
+    internal::kb_builder_t builder(symbols.get(), quests.get(), arena.get());
+    if (!builder.build(reader)) { return false; }
 
-        auto rule = std::make_unique<srule_t>(std::move(id), exp, quest,
-                                              target, out);
-        rules->push_back(std::move(rule));
-    }
+    *kb = new kb_t<std::string>(builder.name);
+    (*kb)->load(symbols.release(), quests.release(), builder.link());
+    (*kb)->retain(std::move(arena));
 
-    return rules;
+    return true;
 }
 
-}
+/**
+ * @brief Loads the knowledge database from the XML file using the pool.
+ *        The first `rules` element is split into chunks which are parsed and
+ *        compiled in parallel with their own symbol tables. Then symbols are
+ *        merged in the order of the document and rules are linked, so the
+ *        result is the same as the sequential loader gives
+ * @param filename Path of the file
+ * @param kb Output knowledge database
+ * @param pool Thread pool
+ * @return False if the file can't be read or it's malformed
+ */
+inline bool load_kb(const std::string &filename, kb_t<std::string> **kb,
+                    thread_pool_t &pool) {
+    mapped_file_t file(filename);
+    if (!file.valid()) { return false; }
+    std::string_view data(file.data(), file.size());
+
+    // Expressions of every chunk are placed in its own arena
+    std::vector<std::shared_ptr<arena_t>> arenas{std::make_shared<arena_t>()};
+    auto symbols = std::make_unique<ssymbols_t>();
+    auto quests = std::make_unique<quests_t<sval_t>>();
+    internal::kb_builder_t builder(symbols.get(), quests.get(),
+                                   arenas.front().get());
+    xml_reader_t head(data.data(), data.size());
+    std::string root;
+    std::size_t begin = 0;
+    for (;;) {
+        auto event = head.next();
+        if (event == xml_reader_t::event_t::eof) { break; }
+        if (event == xml_reader_t::event_t::start && head.depth() == 1) {
+            root = head.name();
+        }
+        if (event == xml_reader_t::event_t::start && head.depth() == 2 &&
+                head.name() == "rules" && !head.empty()) {
+            begin = head.offset();
+            break;
+        }
+        if (!builder.handle(head, event)) { return false; }
+    }
+
+    if (begin) {
+        auto offs = internal::split_rules(data, begin, pool.size() * 4);
+        std::vector<internal::rule_chunk_t> chunks(offs.size());
+        pool.parallel_for(chunks.size(), [&] (std::size_t i) {
+            chunks[i].begin = offs[i];
+            auto next = i + 1 < offs.size() ? offs[i + 1] : data.size();
+            internal::read_chunk(data, root, next, chunks[i]);
+        });
+
+        // Chunks after `</rules>` are dropped, a broken chain of chunks
+        // (e.g. a split point in a comment) is read sequentially
+        std::size_t used = 0;
+        while (used < chunks.size() && chunks[used].ok &&
+               !chunks[used++].last) {}
+        if (!used || !chunks[used - 1].ok || !chunks[used - 1].last) {
+            return load_kb(filename, kb);
+        }
+
+        std::vector<std::vector<sym_t>> ids(used);
+        for (std::size_t i = 0; i < used; ++i) {
+            for (std::size_t sym = 0; sym < chunks[i].symbols.size(); ++sym) {
+                ids[i].push_back(symbols->intern(chunks[i].symbols.value(
+                                                     static_cast<sym_t>(sym))));
+            }
+        }
+        for (std::size_t i = 0; i < used; ++i) {
+            arenas.push_back(std::make_shared<arena_t>());
+        }
+        pool.parallel_for(used, [&] (std::size_t i) {
+            for (auto &rule : chunks[i].rules) {
+                rule.prog.remap(ids[i]);
+                if (rule.out != no_sym) { rule.out = ids[i][rule.out]; }
+                rule.exp.reset(rule.prog.decompile<sval_t>(
+                                   symbols->size(), arenas[i + 1].get()));
+            }
+        });
+        for (std::size_t i = 0; i < used; ++i) {
+            for (auto &rule : chunks[i].rules) {
+                builder.rules.push_back(std::move(rule));
+            }
+        }
+
+        auto end = chunks[used - 1].end;
+        xml_reader_t tail(data.data() + end, data.size() - end, {root});
+        if (!builder.build(tail)) { return false; }
+    }
 
-bool load_kb(const std::string &filename, kb_t<std::string> **kb) {
-    XMLDocument doc;
-    XMLError error = doc.LoadFile(filename.c_str());
-    if (error != XML_SUCCESS) return false;
-    auto root_node = doc.RootElement();
-    *kb = new kb_t<std::string>(root_node->Attribute("name"));
-    auto quests_node = root_node->FirstChildElement("questions");
-    auto quests = internal::parse_questions(quests_node);
-    auto rules_node = root_node->FirstChildElement("rules");
-    auto rules = internal::parse_rules(rules_node, quests);
-    (*kb)->load(quests, rules);
+    *kb = new kb_t<std::string>(builder.name);
+    (*kb)->load(symbols.release(), quests.release(), builder.link());
+    for (auto &arena : arenas) { (*kb)->retain(std::move(arena)); }
 
     return true;
 }
@@ -0,0 +1,30 @@
+#include "image.hpp"
+#include "kb_parser.hpp"
+#include "pool.hpp"
+
+#include <iostream>
+#include <memory>
+
+using namespace xpertium;
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        std::cout << "Usage: " << argv[0] << " <kb.xml> <kb.img>\n";
+        return 1;
+    }
+
+    thread_pool_t pool;
+    kb_t<std::string> *kb;
+    if (!load_kb(argv[1], &kb, pool)) {
+        std::cout << "Can't load knowledge database.\n";
+        return 1;
+    }
+    std::unique_ptr<kb_t<std::string>> owner(kb);
+
+    if (!save_image(*kb, argv[2])) {
+        std::cout << "Can't write image.\n";
+        return 1;
+    }
+
+    return 0;
+}
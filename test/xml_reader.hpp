@@ -0,0 +1,313 @@
+#ifndef XML_READER_HPP
+#define XML_READER_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace xpertium {
+
+/**
+ * This class is a pull parser of XML. It reads the stream by chunks (or a
+ * part of the document in memory) and reports elements one by one, so only
+ * the current element and the stack of open element names are kept. Text,
+ * comments, processing instructions and declarations are skipped
+ */
+class xml_reader_t {
+public:
+    /**
+     * Events of the parser
+     */
+    enum class event_t {
+        start, ///< An element is opened, its name and attributes are ready
+        end,   ///< An element is closed (also reported for `<a/>`)
+        eof,   ///< The document is finished
+        error  ///< The document is malformed
+    };
+private:
+    static constexpr std::size_t chunk_size = 64 * 1024;
+
+    std::istream *m_in = nullptr;
+    std::vector<char> m_buf;
+    const char *m_data;
+    std::size_t m_base = 0;
+    std::size_t m_pos = 0;
+    std::size_t m_len = 0;
+    std::size_t m_tag = 0;
+    std::string m_name;
+    std::vector<std::pair<std::string, std::string>> m_attrs;
+    std::vector<std::string> m_open;
+    bool m_empty = false;
+public:
+    /**
+     * @brief Constructor
+     * @param in Input stream
+     */
+    explicit xml_reader_t(std::istream &in) :
+        m_in{&in}, m_buf(chunk_size), m_data{m_buf.data()} {}
+
+    /**
+     * @brief Constructor of a reader of a document part in memory
+     * @param data Characters
+     * @param size Number of characters
+     * @param open Names of elements which are open at the start
+     */
+    xml_reader_t(const char *data, std::size_t size,
+                 std::vector<std::string> open = {}) :
+        m_data{data}, m_len{size}, m_open{std::move(open)} {}
+
+    xml_reader_t(const xml_reader_t &) = delete;
+    xml_reader_t &operator=(const xml_reader_t &) = delete;
+
+    /**
+     * @brief Reads the next element event
+     */
+    event_t next() {
+        if (m_empty) {
+            m_empty = false;
+            return event_t::end;
+        }
+
+        int ch;
+        while ((ch = get()) != '<') {
+            if (ch >= 0) { continue; }
+            return m_open.empty() ? event_t::eof : event_t::error;
+        }
+        m_tag = offset() - 1;
+
+        ch = get();
+        if (ch == '?') { return skip("?>") ? next() : event_t::error; }
+        if (ch == '!') { return skip_markup() ? next() : event_t::error; }
+        if (ch == '/') { return end_tag(); }
+
+        m_name.clear();
+        m_attrs.clear();
+        if (!read_name(ch, m_name)) { return event_t::error; }
+        for (;;) {
+            ch = skip_spaces();
+            if (ch == '>') {
+                m_open.push_back(m_name);
+                return event_t::start;
+            }
+            if (ch == '/') {
+                m_empty = true;
+                return get() == '>' ? event_t::start : event_t::error;
+            }
+
+            std::string name, value;
+            if (!read_name(ch, name) || skip_spaces() != '=') {
+                return event_t::error;
+            }
+            auto quote = skip_spaces();
+            if ((quote != '"' && quote != '\'') || !read_value(quote, value)) {
+                return event_t::error;
+            }
+            m_attrs.emplace_back(std::move(name), std::move(value));
+        }
+    }
+
+    /**
+     * @brief Returns the name of the current element
+     */
+    const std::string &name() const { return m_name; }
+
+    /**
+     * @brief Returns the name of the element which contains the current one
+     *        or an empty string for the root element
+     */
+    const std::string &parent() const {
+        static const std::string none;
+        auto depth = this->depth();
+        return depth > 1 ? m_open[depth - 2] : none;
+    }
+
+    /**
+     * @brief Returns a value of the attribute of the current element
+     * @param name Attribute name
+     * @return Value or `nullptr` if the element hasn't the attribute
+     */
+    const char *attribute(const char *name) const {
+        for (const auto &attr : m_attrs) {
+            if (attr.first == name) { return attr.second.c_str(); }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Returns a number of open elements including the current one
+     */
+    std::size_t depth() const { return m_open.size() + m_empty; }
+
+    /**
+     * @brief Returns `true` if the current element is written as `<a/>`
+     */
+    bool empty() const { return m_empty; }
+
+    /**
+     * @brief Returns a number of read characters
+     */
+    std::size_t offset() const { return m_base + m_pos; }
+
+    /**
+     * @brief Returns an offset of `<` of the last read tag
+     */
+    std::size_t tag_offset() const { return m_tag; }
+private:
+    int get() {
+        if (m_pos == m_len) {
+            if (!m_in) { return -1; }
+            m_in->read(m_buf.data(),
+                       static_cast<std::streamsize>(m_buf.size()));
+            m_base += m_len;
+            m_len = static_cast<std::size_t>(m_in->gcount());
+            m_pos = 0;
+            if (!m_len) { return -1; }
+        }
+        return static_cast<unsigned char>(m_data[m_pos++]);
+    }
+
+    int skip_spaces() {
+        int ch;
+        do { ch = get(); } while (ch == ' ' || ch == '\t' || ch == '\n' ||
+                                  ch == '\r');
+        return ch;
+    }
+
+    /**
+     * @brief Skips characters until the terminator is passed
+     */
+    bool skip(const char *term) {
+        auto len = std::strlen(term);
+        std::size_t matched = 0;
+        while (matched != len) {
+            auto ch = get();
+            if (ch < 0) { return false; }
+            // Terminators like `]]>` overlap themselves, so a mismatch keeps
+            // the longest matched part which can still start the terminator
+            while (matched && ch != term[matched]) {
+                matched = border(term, matched);
+            }
+            if (ch == term[matched]) { ++matched; }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Returns a length of the longest proper prefix of `term[0, n)`
+     *        which is also its suffix
+     */
+    static std::size_t border(const char *term, std::size_t n) {
+        for (auto len = n - 1; len; --len) {
+            if (!std::memcmp(term, term + n - len, len)) { return len; }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Skips a comment, CDATA or a declaration after `<!`
+     */
+    bool skip_markup() {
+        auto ch = get();
+        if (ch == '-') { return get() == '-' && skip("-->"); }
+        if (ch == '[') { return skip("]]>"); }
+
+        // Declarations can contain an internal subset in brackets
+        int depth = 0;
+        for (; ch >= 0; ch = get()) {
+            if (ch == '[') { ++depth; }
+            else if (ch == ']') { --depth; }
+            else if (ch == '>' && depth <= 0) { return true; }
+        }
+        return false;
+    }
+
+    event_t end_tag() {
+        m_name.clear();
+        m_attrs.clear();
+        if (!read_name(get(), m_name) || skip_spaces() != '>' ||
+                m_open.empty() || m_open.back() != m_name) {
+            return event_t::error;
+        }
+        m_open.pop_back();
+
+        return event_t::end;
+    }
+
+    bool read_name(int ch, std::string &name) {
+        while (ch >= 0 && ch != '>' && ch != '/' && ch != '=' && ch != ' ' &&
+               ch != '\t' && ch != '\n' && ch != '\r') {
+            name += static_cast<char>(ch);
+            ch = get();
+        }
+        if (ch >= 0) { --m_pos; }
+
+        return !name.empty();
+    }
+
+    bool read_value(int quote, std::string &value) {
+        for (auto ch = get(); ch != quote; ch = get()) {
+            if (ch < 0 || ch == '<') { return false; }
+            if (ch != '&') {
+                value += static_cast<char>(ch);
+                continue;
+            }
+
+            std::string ref;
+            for (ch = get(); ch != ';'; ch = get()) {
+                if (ch < 0 || ch == quote || ref.size() > 8) { return false; }
+                ref += static_cast<char>(ch);
+            }
+            if (!entity(ref, value)) { value += '&' + ref + ';'; }
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Appends the character referred by the entity
+     * @return False if the entity is unknown
+     */
+    static bool entity(const std::string &ref, std::string &value) {
+        if (ref == "lt") { value += '<'; }
+        else if (ref == "gt") { value += '>'; }
+        else if (ref == "amp") { value += '&'; }
+        else if (ref == "quot") { value += '"'; }
+        else if (ref == "apos") { value += '\''; }
+        else if (ref.size() > 1 && ref[0] == '#') {
+            bool hex = ref[1] == 'x';
+            auto digits = ref.c_str() + 1 + hex;
+            char *end;
+            auto code = std::strtoul(digits, &end, hex ? 16 : 10);
+            if (!*digits || *end || code > 0x10ffff) { return false; }
+            utf8(static_cast<std::uint32_t>(code), value);
+        } else { return false; }
+
+        return true;
+    }
+
+    static void utf8(std::uint32_t code, std::string &out) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xc0 | code >> 6);
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xe0 | code >> 12);
+            out += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        } else {
+            out += static_cast<char>(0xf0 | code >> 18);
+            out += static_cast<char>(0x80 | (code >> 12 & 0x3f));
+            out += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        }
+    }
+};
+
+}
+
+#endif // XML_READER_HPP